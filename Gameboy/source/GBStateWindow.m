@@ -152,10 +152,13 @@
     [self setHex16:[self textBoxSP] value:state->sp];
     [self setHex16:[self textBoxPC] value:state->pc];
 
-    [self setDecimal:[self textBoxFZ] value:state->f.z];
-    [self setDecimal:[self textBoxFN] value:state->f.n];
-    [self setDecimal:[self textBoxFH] value:state->f.h];
-    [self setDecimal:[self textBoxFC] value:state->f.c];
+    // The processor may not have worked out the flags from the last op yet
+    GBProcessorFlags flags = { .reg = GBProcessorReadFlags(gameboy->cpu) };
+
+    [self setDecimal:[self textBoxFZ] value:flags.z];
+    [self setDecimal:[self textBoxFN] value:flags.n];
+    [self setDecimal:[self textBoxFH] value:flags.h];
+    [self setDecimal:[self textBoxFC] value:flags.c];
 
     [self setDecimal:[self textBoxIME] value:state->ime];
     [self setHex16:[self textBoxMAR] value:state->mar];
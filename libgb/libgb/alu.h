@@ -0,0 +1,35 @@
+#ifndef __LIBGB_ALU__
+#define __LIBGB_ALU__ 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Flags as they sit in f
+#define kGBFlagZero         (1 << 7)
+#define kGBFlagSubtract     (1 << 6)
+#define kGBFlagHalfCarry    (1 << 5)
+#define kGBFlagCarry        (1 << 4)
+#define kGBFlagMask         0xF0
+
+// The prefixed rotates and shifts, in the order they appear from 0x00 --> 0x3F
+enum {
+    kGBALUShiftRLC      = 0,
+    kGBALUShiftRRC      = 1,
+    kGBALUShiftRL       = 2,
+    kGBALUShiftRR       = 3,
+    kGBALUShiftSLA      = 4,
+    kGBALUShiftSRA      = 5,
+    kGBALUShiftSwap     = 6,
+    kGBALUShiftSRL      = 7,
+
+    kGBALUShiftCount    = 8
+};
+
+// Each entry is result << 8 | flags, so an op gets both from one load.
+// The tables are filled in when the library is loaded.
+extern uint16_t gGBALUAdd[2][0x10000];                          // [carry in][left << 8 | right]
+extern uint16_t gGBALUSub[2][0x10000];                          // [carry in][left << 8 | right]
+extern uint16_t gGBALUDecimalAdjust[0x800];                     // (n, h, c) << 8 | a
+extern uint16_t gGBALUShift[kGBALUShiftCount][2][0x100];        // [op][carry in][value]
+
+#endif /* !defined(__LIBGB_ALU__) */
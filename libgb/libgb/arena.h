@@ -0,0 +1,38 @@
+#ifndef __LIBGB_ARENA__
+#define __LIBGB_ARENA__ 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A whole machine can be allocated out of one block instead of one malloc per component.
+// Every allocation starts on its own cache line, and components made one after another sit next to each other.
+// The block is reserved up front. Pages past what is used are never touched (and are given back by GBArenaTrim).
+
+#define kGBArenaAlignment   64          // One cache line
+#define kGBArenaReserve     0x1000000   // 16 MB of address space for a machine
+
+typedef struct __GBArena {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+} GBArena;
+
+GBArena *GBArenaCreate(size_t size);
+void GBArenaDestroy(GBArena *this);
+
+// Give back the pages after the last allocation. Nothing more can be allocated afterwards.
+void GBArenaTrim(GBArena *this);
+
+bool GBArenaContains(GBArena *this, const void *pointer);
+
+// While an arena is current, GBAllocate on this thread takes memory from it. NULL goes back to malloc.
+void GBArenaSetCurrent(GBArena *arena);
+GBArena *GBArenaGetCurrent(void);
+
+// Memory for machine components. Arena memory is only given back with the whole arena, so
+// GBRelease ignores pointers into the current arena (and frees everything else).
+void *GBAllocate(size_t size);
+void GBRelease(void *pointer);
+
+#endif /* !defined(__LIBGB_ARENA__) */
@@ -9,6 +9,7 @@
 
 struct __GBGameboy;
 struct __GBBIOSROM;
+struct __GBMemoryManager;
 
 typedef struct __GBBIOSMaskPort {
     uint16_t address; // 0xFF50
@@ -35,6 +36,7 @@ typedef struct __GBBIOSROM {
 
     bool masked;
     GBBIOSMaskPort *port;
+    struct __GBMemoryManager *mmu; // Set once installed
     uint8_t data[kGBBIOSROMSize];
 } GBBIOSROM;
 
@@ -4,6 +4,7 @@
 #include <libgb/mmu.h>
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 struct __GBGameboy;
@@ -20,7 +21,7 @@ struct __GBGameboy;
 #define kGBCartHeaderStart          0x0100
 
 typedef struct {
-    uint8_t entry[3];
+    uint8_t entry[4];
     uint8_t logo[48];
     uint8_t title[11];
     uint8_t maker[4];
@@ -48,34 +49,101 @@ typedef struct __GBCartROM {
     uint16_t start;
     uint16_t end;
 
-    uint8_t maxBank;
+    uint16_t maxBank;
     uint8_t *romData;
-    uint8_t bank;
+    uint16_t bank;
+
+    // Where the banks mapped at 0x0000 and 0x4000 start in romData. Banked reads are one add and one load.
+    uint16_t lowBank;
+    uint8_t *lowStart;
+    uint8_t *bankStart;
+
+    // Mapper registers
+    uint16_t bankSelect; // ROM bank number written to the MBC
+    uint8_t bankHigh;    // MBC1 upper ROM bits, or the RAM bank
+    bool bankMode;       // MBC1 only
+    bool ramEnabled;
+
+    bool shared; // romData belongs to someone else (it isn't freed with the ROM)
 
-    // Some MBCs have the ability to enable/disable their on-cart (built in) RAM
-    bool *ramEnable;
+    GBMemoryManager *mmu; // Set while installed
+
+    // MBCs switch and enable the on-cart RAM (NULL if there isn't any)
+    struct __GBCartRAM *ram;
 
     bool installed;
     bool (*eject)(struct __GBCartROM *this, struct __GBGameboy *gameboy);
 } GBCartROM;
 
-GBCartROM *GBCartROMCreateGeneric(uint8_t *romData, uint8_t banks, uint8_t (*readFunc)(struct __GBCartROM *this, uint16_t address), void (*writeFunc)(struct __GBCartROM *this, uint16_t address, uint8_t byte));
+GBCartROM *GBCartROMCreateGeneric(uint8_t *romData, uint16_t banks, uint8_t (*readFunc)(struct __GBCartROM *this, uint16_t address), void (*writeFunc)(struct __GBCartROM *this, uint16_t address, uint8_t byte));
+
+// Uses romData in place instead of copying it. It has to outlive the ROM.
+GBCartROM *GBCartROMCreateGenericShared(uint8_t *romData, uint16_t banks, uint8_t (*readFunc)(struct __GBCartROM *this, uint16_t address), void (*writeFunc)(struct __GBCartROM *this, uint16_t address, uint8_t byte));
 
-GBCartROM *GBCartROMCreateWithNullMapper(uint8_t *romData, uint8_t banks);
-GBCartROM *GBCartROMCreateWithMBC1(uint8_t *romData, uint8_t banks);
-GBCartROM *GBCartROMCreateWithMBC2(uint8_t *romData, uint8_t banks);
-GBCartROM *GBCartROMCreateWithMBC3(uint8_t *romData, uint8_t banks);
-GBCartROM *GBCartROMCreateWithMBC4(uint8_t *romData, uint8_t banks);
-GBCartROM *GBCartROMCreateWithMBC5(uint8_t *romData, uint8_t banks);
+GBCartROM *GBCartROMCreateWithNullMapper(uint8_t *romData, uint16_t banks);
+GBCartROM *GBCartROMCreateWithMBC1(uint8_t *romData, uint16_t banks);
+GBCartROM *GBCartROMCreateWithMBC2(uint8_t *romData, uint16_t banks);
+GBCartROM *GBCartROMCreateWithMBC3(uint8_t *romData, uint16_t banks);
+GBCartROM *GBCartROMCreateWithMBC5(uint8_t *romData, uint16_t banks);
 void GBCartROMDestroy(GBCartROM *this);
 
 void GBCartROMWriteNull(GBCartROM *this, uint16_t address, uint8_t byte);
 void GBCartROMWriteMBC1(GBCartROM *this, uint16_t address, uint8_t byte);
+void GBCartROMWriteMBC2(GBCartROM *this, uint16_t address, uint8_t byte);
+void GBCartROMWriteMBC3(GBCartROM *this, uint16_t address, uint8_t byte);
+void GBCartROMWriteMBC5(GBCartROM *this, uint16_t address, uint8_t byte);
 uint8_t GBCartROMReadBanked(GBCartROM *this, uint16_t address);
 
+// Switch the banks at 0x0000 and 0x4000 (wrapped to the banks there are). This updates the cached pointers and pages.
+void __GBCartROMSelectBanks(GBCartROM *this, uint16_t lowBank, uint16_t bank);
+
+// Point the memory manager's pages at the current banks. Call after changing bank.
+void __GBCartROMMapPages(GBCartROM *this);
+
 bool GBCartROMOnInstall(GBCartROM *this, struct __GBGameboy *gameboy);
 bool GBCartROMOnEject(GBCartROM *this, struct __GBGameboy *gameboy);
 
+#pragma mark - Clock
+
+// MBC3 clock registers (selected through the RAM bank register)
+#define kGBCartRTCSeconds           0x08
+#define kGBCartRTCMinutes           0x09
+#define kGBCartRTCHours             0x0A
+#define kGBCartRTCDaysLow           0x0B
+#define kGBCartRTCDaysHigh          0x0C
+
+#define kGBCartRTCHaltFlag          (1 << 6)
+#define kGBCartRTCCarryFlag         (1 << 7)
+
+#define kGBCartRTCTicksPerSecond    0x400000
+
+// The clock is never ticked. Its time is worked out when the game latches or writes it,
+// from the time it had at `baseTick` plus how far the emulated clock has run since.
+typedef struct __GBCartRTC {
+    uint64_t *tick; // The gameboy's clock while installed (NULL otherwise)
+
+    uint64_t baseTick;
+    uint64_t baseTime; // In clock ticks. Days wrap at 512 (and set carry).
+
+    bool halted;
+    bool carry;
+
+    uint8_t latch;       // Last byte written to the latch register
+    uint8_t latched[5];  // What the game reads back, from seconds to days high
+} GBCartRTC;
+
+GBCartRTC *GBCartRTCCreate(void);
+void GBCartRTCDestroy(GBCartRTC *this);
+
+// Write to the latch register. Writing 0 and then 1 copies the current time into the registers the game reads.
+void GBCartRTCLatch(GBCartRTC *this, uint8_t byte);
+
+uint8_t GBCartRTCRead(GBCartRTC *this, uint8_t reg);
+void GBCartRTCWrite(GBCartRTC *this, uint8_t reg, uint8_t byte);
+
+// Start counting from a new emulated clock (NULL stops the clock where it is).
+void __GBCartRTCSetClock(GBCartRTC *this, uint64_t *tick);
+
 #pragma mark - RAM
 
 typedef struct __GBCartRAM {
@@ -91,17 +159,55 @@ typedef struct __GBCartRAM {
     uint8_t *ramData;
     uint8_t bank;
 
+    uint32_t size; // Bytes of RAM on the cart (can be less than a bank)
+
+    // Where the current bank starts in ramData. Carts with less than a bank repeat it every bankMask + 1 bytes.
+    uint8_t *bankStart;
+    uint16_t bankMask;
+
+    uint8_t unusedBits; // Read back as set (MBC2 RAM only keeps the low nibble)
+
+    // MBC3 clock. While one of its registers is selected, reads and writes go to it instead of RAM.
+    GBCartRTC *rtc;
+    uint8_t rtcRegister;
+
+    GBMemoryManager *mmu; // Set while installed
+
+    // ramData is a shared mapping of a save file. Writes mark the host pages they touch for the next flush.
+    bool mapped;
+    bool dirty;
+    bool *dirtyPages;
+    uint32_t dirtyPageSize;
+    uint32_t dirtyPageCount;
+
     bool enabled;
     bool installed;
     bool (*eject)(struct __GBCartRAM *this, struct __GBGameboy *gameboy);
 } GBCartRAM;
 
 GBCartRAM *GBCartRAMCreateWithBanks(uint8_t banks);
+GBCartRAM *GBCartRAMCreateWithSize(uint32_t size);
 void GBCartRAMDestroy(GBCartRAM *this);
 
 void GBCartRAMWriteDirect(GBCartRAM *this, uint16_t address, uint8_t byte);
 uint8_t GBCartRAMReadDirect(GBCartRAM *this, uint16_t address);
 
+// Switch bank (wrapped to the banks there are) and enable or disable RAM. This updates the cached pointer and pages.
+void __GBCartRAMSelectBank(GBCartRAM *this, bool enabled, uint8_t bank);
+
+// Point 0xA000 --> 0xBFFF at a clock register instead of RAM
+void __GBCartRAMSelectClock(GBCartRAM *this, bool enabled, uint8_t reg);
+
+// Point the memory manager's pages at the current bank (or away from RAM while it's disabled). Call after changing bank or enable.
+void __GBCartRAMMapPages(GBCartRAM *this);
+void __GBCartRAMReleaseData(GBCartRAM *this);
+
+// Keep RAM in a save file from now on. The file is created (with the current contents) or resized if it has to be.
+bool GBCartRAMAttachFile(GBCartRAM *this, const char *path);
+
+// Write pages changed since the last flush back to the save file. Waits for the disk if `wait` is set.
+void GBCartRAMFlush(GBCartRAM *this, bool wait);
+
 bool GBCartRAMOnInstall(GBCartRAM *this, struct __GBGameboy *gameboy);
 bool GBCartRAMOnEject(GBCartRAM *this, struct __GBGameboy *gameboy);
 
@@ -145,18 +251,34 @@ typedef struct __GBCartridge {
     GBCartROM *rom;
     GBCartRAM *ram;
 
+    // The ROM file, if the ROM reads straight out of it (NULL otherwise)
+    void *mapping;
+    size_t mappingSize;
+
     bool installed;
 } GBCartridge;
 
 GBCartridge *GBCartridgeCreate(uint8_t *romData, uint32_t romSize);
+
+// Map a ROM file read only and run from the mapping. Nothing is copied, and
+// every cartridge made from the same file shares the same pages.
+GBCartridge *GBCartridgeCreateWithFile(const char *path);
 GBCartHeader *GBCartridgeGetHeader(GBCartridge *cart);
 
+// Keep battery backed RAM in a save file. Returns false if the cart has no battery or the file can't be used.
+bool GBCartridgeAttachSave(GBCartridge *this, const char *path);
+
 bool GBCartridgeChecksumIsValid(GBCartridge *this);
 void GBCartridgeDestroy(GBCartridge *this);
 
 bool GBCartridgeUnmap(GBCartridge *this, struct __GBGameboy *gameboy);
 bool GBCartridgeMap(GBCartridge *this, struct __GBGameboy *gameboy);
 
+// The mapper registers, clock and RAM contents, for snapshots. Restoring remaps the banks and marks changed save pages dirty.
+size_t GBCartridgeStateSize(GBCartridge *this);
+void GBCartridgeSaveState(GBCartridge *this, void *buffer);
+void GBCartridgeRestoreState(GBCartridge *this, const void *buffer);
+
 bool GBCartMemGenericOnEject(GBMemorySpace *this, struct __GBGameboy *gameboy);
 
 #endif /* !defined(__LIBGB_CART__) */
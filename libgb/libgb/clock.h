@@ -5,6 +5,7 @@
 #include <stdint.h>
 
 struct __GBGameboy;
+struct __GBClock;
 
 #pragma mark - Timer Registers
 
@@ -22,10 +23,16 @@ typedef struct __GBTimerPort {
     uint8_t (*read)(struct __GBTimerPort *this);
 
     uint8_t value;
+
+    // Writes to the divider and timer control change when the next timer event happens.
+    struct __GBClock *clock;
 } GBTimerPort;
 
 GBTimerPort *GBTimerPortCreate(uint16_t address);
 void __GBDividerPortWrite(GBTimerPort *port, uint8_t byte);
+uint8_t __GBDividerPortRead(GBTimerPort *port);
+void __GBTimerPortWrite(GBTimerPort *port, uint8_t byte);
+void __GBTimerControlPortWrite(GBTimerPort *port, uint8_t byte);
 uint8_t __GBTimerControlPortRead(GBTimerPort *port);
 
 // 0, 1, 2, 3
@@ -43,27 +50,57 @@ uint8_t __GBTimerControlPortRead(GBTimerPort *port);
 
 #pragma mark - Internal Clock
 
+// Instead of ticking every component on every dot, each component tells the clock the next tick it has something to do.
+// The clock then jumps straight to the earliest of these and only runs the components which are due.
+// Events which come due on the same tick are run in the order below (the same order the components used to be ticked in).
+enum {
+    kGBClockEventTimer      = 0,
+    kGBClockEventMemory     = 1,
+    kGBClockEventDriver     = 2,
+    kGBClockEventProcessor  = 3,
+    kGBClockEventDMA        = 4,
+
+    kGBClockEventCount      = 5
+};
+
+#define kGBClockNever           UINT64_MAX
+
+// TIMA is reloaded from TMA (and the interrupt is requested) this many ticks after it overflows.
+#define kGBTimerOverflowDelay   4
+
 typedef struct __GBClock {
     bool (*install)(struct __GBClock *this, struct __GBGameboy *gameboy);
 
     GBTimerPort *divider;
     GBTimerPort *timer;
-    GBTimerPort *timerModulus;
     GBTimerPort *timerControl;
+    uint8_t *timerModulus; // Plain register in the I/O register file (set on install)
 
-    uint8_t overflowTicks;
+    uint64_t overflowTick; // The tick TIMA will be reloaded on
     bool timerOverflow;
 
     uint64_t internalTick;
     uint16_t tick;
 
+    uint64_t events[kGBClockEventCount]; // The next tick each component needs to run on
+    uint64_t frameLimit; // GBClockAdvance returns once the driver's frame count reaches this
+
     struct __GBGameboy *gameboy;
 } GBClock;
 
 GBClock *GBClockCreate(void);
 void GBClockTick(GBClock *this);
+
+// Run the next `ticks` ticks. Returns the number actually run (fewer if the frame limit was hit or the processor was turned off).
+uint64_t GBClockAdvance(GBClock *this, uint64_t ticks);
+
 void GBClockDestroy(GBClock *this);
 
+// Request that the given component runs no later than `tick`.
+void GBClockSchedule(GBClock *this, uint8_t event, uint64_t tick);
+
 bool __GBClockInstall(GBClock *this, struct __GBGameboy *gameboy);
+void __GBClockTimerTick(GBClock *this, uint64_t tick);
+uint64_t __GBClockTimerNextEvent(GBClock *this, uint64_t tick);
 
 #endif /* !defined(__LIBGB_CLOCK__) */
@@ -5,6 +5,8 @@
 #include <stdint.h>
 
 #include <libgb/mmu.h>
+#include <libgb/alu.h>
+#include <libgb/jit.h>
 #include <libgb/ic.h>
 
 #define GBRegisterPair(h, l)        \
@@ -30,6 +32,63 @@ enum {
     kGBProcessorModeWait4       =  9
 };
 
+// The micro-stepped core runs one tick at a time and waits on the memory manager for every access.
+// The fast core runs the same ops on a synchronous bus (every access is done as soon as it is made) and finishes a whole instruction at once.
+// Bus timing inside an instruction is lost.
+// The threaded core behaves exactly like the fast core, but runs every op inside one function (see threaded.c).
+enum {
+    kGBProcessorCoreMicro       = 0,
+    kGBProcessorCoreFast        = 1,
+    kGBProcessorCoreThreaded    = 2
+};
+
+// Ticks taken by every memory access (the memory manager runs at 1 MHz)
+#define kGBProcessorAccessCycles    4
+
+// Polling loops longer than this aren't considered idle
+#define kGBIdleLoopMaxSize          16
+
+// Registers an idle loop reads memory through
+enum {
+    kGBIdleLoopReadHL   = (1 << 0),
+    kGBIdleLoopReadBC   = (1 << 1),
+    kGBIdleLoopReadDE   = (1 << 2),
+    kGBIdleLoopReadC    = (1 << 3)  // 0xFF00 + c
+};
+
+// Length in bytes of every unprefixed op (prefixed ops are always 2)
+extern const uint8_t gGBInstructionLengths[0x100];
+
+// With lazy flags, ops which set every flag (add, adc, sub, sbc, cp, and, or, xor, inc, dec) only remember their operands.
+// f is worked out from them the next time anything reads it (a conditional branch, push af, daa, the debugger).
+// Build with kGBProcessorLazyFlags set to 0 to work out flags after every op instead.
+#ifndef kGBProcessorLazyFlags
+    #define kGBProcessorLazyFlags 1
+#endif /* !defined(kGBProcessorLazyFlags) */
+
+// The op f is waiting to be worked out from
+enum {
+    kGBLazyFlagsNone    = 0,
+    kGBLazyFlagsAdd     = 1,
+    kGBLazyFlagsSub     = 2,
+    kGBLazyFlagsInc     = 3,
+    kGBLazyFlagsDec     = 4,
+    kGBLazyFlagsAnd     = 5,
+    kGBLazyFlagsOr      = 6 // Also xor
+};
+
+typedef union {
+    struct {
+        uint8_t ext:4;
+        uint8_t c:1;
+        uint8_t h:1;
+        uint8_t n:1;
+        uint8_t z:1;
+    };
+
+    uint8_t reg;
+} GBProcessorFlags;
+
 typedef struct __GBProcessorOP {
     const char *name;
     uint8_t value;
@@ -52,17 +111,16 @@ typedef struct __GBProcessor {
 
         uint16_t sp, pc;
 
-        union {
-            struct {
-                uint8_t ext:4;
-                uint8_t c:1;
-                uint8_t h:1;
-                uint8_t n:1;
-                uint8_t z:1;
-            };
+        GBProcessorFlags f; // Only up to date once any pending lazy flags are worked out
 
-            uint8_t reg;
-        } f;
+        // The last op which set every flag, if f hasn't been worked out from it yet
+        struct {
+            uint8_t op;
+            uint8_t left;
+            uint8_t right;
+            uint8_t carry; // Carry in for add/sub, carry kept for inc/dec
+            uint8_t result;
+        } lazy;
 
         uint16_t mar;
         uint8_t mdr;
@@ -74,19 +132,79 @@ typedef struct __GBProcessor {
 
         int8_t mode;
         bool bug;
+
+        uint16_t cycles; // Ticks taken by the last instruction (fast cores only)
     } state;
 
+    uint8_t core;
+
+    // Translated ROM code for the fast cores (NULL until the JIT is turned on)
+    GBProcessorJIT *jit;
+
+    // Predecoded runs of code for the fast cores (NULL on the micro-stepped core)
+    GBProcessorDecodeCache *cache;
+
+    // A short backward loop which only reads memory that changes on clock events (like `ldh a, (0x44); cp N; jr nz`).
+    // Once an iteration leaves the registers as it found them with no events in between,
+    // the fast cores skip whole iterations up to the next event.
+    struct {
+        bool enabled;
+        bool valid; // The loop from head --> end only polls
+        bool armed; // We were at the head last time with no interrupt in between
+
+        uint16_t head;
+        uint16_t end;
+        uint8_t reads;
+
+        uint16_t lastPC;
+        uint32_t cycles; // Ticks since we were last at the head
+        uint32_t budget; // Budget we had last time we were at the head
+
+        uint8_t a, f;
+        uint16_t bc, de, hl, sp;
+
+        uint64_t detections;    // Loops found to only poll
+        uint64_t skips;         // Times we skipped ahead
+        uint64_t skippedTicks;  // Ticks skipped in total
+    } idle;
+
+    // Ticks until anything other than the processor has to run (set by the clock before each processor event)
+    uint32_t budget;
+
     GBProcessorOP *decode_prefix[0x100];
     GBProcessorOP *decode[0x100];
 
     void (*tick)(struct __GBProcessor *this, uint64_t tick);
+    uint64_t (*nextEvent)(struct __GBProcessor *this, uint64_t tick);
 } GBProcessor;
 
-GBProcessor *GBProcessorCreate(void);
+GBProcessor *GBProcessorCreate(uint8_t core);
 void GBDispatchOP(GBProcessor *this);
 void GBProcessorDestroy(GBProcessor *this);
 
+// Returns f, working out any pending lazy flags first. Anything outside the ops should read the flags through this.
+uint8_t GBProcessorReadFlags(GBProcessor *this);
+
 void __GBProcessorTick(GBProcessor *this, uint64_t tick);
+uint64_t __GBProcessorNextEvent(GBProcessor *this, uint64_t tick);
+
+// Runs a whole instruction (or interrupt dispatch) on the fast core. Returns the number of ticks it took.
+uint16_t GBProcessorFastStep(GBProcessor *this);
+
+// Same as GBProcessorFastStep, but dispatches ops from one function instead of through the decode tables.
+uint16_t GBProcessorThreadedStep(GBProcessor *this);
+
+// Handles halt, interrupt dispatch, and instruction fetch for the fast cores.
+// Returns true when an op has been fetched and is ready to run.
+bool __GBProcessorFastFetch(GBProcessor *this);
+
+// Reads the next opcode (and the prefixed opcode after 0xCB) and gets ready to run it.
+void __GBProcessorFastDecode(GBProcessor *this);
+
+void __GBProcessorFastTick(GBProcessor *this, uint64_t tick);
+uint64_t __GBProcessorFastNextEvent(GBProcessor *this, uint64_t tick);
+
+void __GBProcessorThreadedTick(GBProcessor *this, uint64_t tick);
 
 typedef struct __GBProcessorState GBProcessorState;
 
@@ -0,0 +1,84 @@
+#ifndef __LIBGB_DECODE__
+#define __LIBGB_DECODE__ 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct __GBProcessor;
+struct __GBCartROM;
+
+// The decode cache remembers the opcodes of straight-line runs of code for the fast processor cores.
+// Runs are found by ROM bank and PC. Fetching the next instruction of a run skips the memory manager and the decode.
+// Runs in work RAM and high RAM are thrown away as soon as anything writes over them.
+// Ops still read their own arguments over the bus, so only the opcode fetch is skipped.
+
+#define kGBDecodeCacheMaxRun        64
+
+#define kGBDecodeCacheROMOps        0x10000
+#define kGBDecodeCacheROMRuns       0x4000
+#define kGBDecodeCacheRAMOps        0x1000
+#define kGBDecodeCacheRAMRuns       0x400
+#define kGBDecodeCacheBucketCount   0x800
+
+// Writes are watched in 32-byte lines
+#define kGBDecodeCacheLineShift     5
+#define kGBDecodeCacheMapSize       (0x10000 >> (kGBDecodeCacheLineShift + 3))
+
+// Keys above the ROM banks (MBC5 has up to 0x1FF)
+#define kGBDecodeCacheKeyBIOS       (0x400 << 16)
+#define kGBDecodeCacheKeyRAM        (0x200 << 16)
+
+typedef struct __GBDecodedOP {
+    uint32_t key; // ROM bank << 16 | PC
+    uint8_t op;
+    bool prefix;
+    bool last; // The run ends after this op
+} GBDecodedOP;
+
+typedef struct __GBDecodedRun {
+    uint32_t key;
+    GBDecodedOP *ops;
+
+    struct __GBDecodedRun *next;
+} GBDecodedRun;
+
+typedef struct {
+    GBDecodedOP *ops;
+    uint32_t opCount;
+    uint32_t opMax;
+
+    GBDecodedRun *runs;
+    uint32_t runCount;
+    uint32_t runMax;
+
+    GBDecodedRun *buckets[kGBDecodeCacheBucketCount];
+} GBDecodeCachePool;
+
+typedef struct __GBProcessorDecodeCache {
+    struct __GBCartROM *rom;
+
+    GBDecodeCachePool romPool;
+    GBDecodeCachePool ramPool;
+
+    // The op after the last one fetched (if it is still the same run)
+    GBDecodedOP *next;
+
+    // Lines of RAM with cached code (shared with the memory manager)
+    uint8_t codeMap[kGBDecodeCacheMapSize];
+
+    uint64_t hits;          // Fetches served from the cache
+    uint64_t misses;        // Fetches which decoded a new run
+    uint64_t uncached;      // Fetches from memory we don't cache (VRAM, cart RAM, during DMA)
+    uint64_t invalidations; // Times RAM runs were thrown away
+} GBProcessorDecodeCache;
+
+GBProcessorDecodeCache *GBProcessorDecodeCacheCreate(void);
+void GBProcessorDecodeCacheDestroy(GBProcessorDecodeCache *this);
+
+// Throw away every cached run (the ROM changed)
+void GBProcessorDecodeCacheFlush(GBProcessorDecodeCache *this);
+
+// Fetch the next op from the cache. Returns false if the processor has to fetch it from memory.
+bool GBProcessorDecodeCacheFetch(GBProcessorDecodeCache *this, struct __GBProcessor *cpu);
+
+#endif /* !defined(__LIBGB_DECODE__) */
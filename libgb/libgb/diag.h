@@ -0,0 +1,38 @@
+#ifndef __LIBGB_DIAG__
+#define __LIBGB_DIAG__ 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Accesses to memory nothing answers for are counted here instead of printed.
+// Only the first access of each kind to an address is logged, so a ROM polling
+// echo RAM or a missing I/O port in a loop costs an increment per access.
+// Counters are shared by every gameboy in the process and are safe to bump from any thread.
+
+enum {
+    kGBDiagnosticUnmappedRead   = 0,
+    kGBDiagnosticUnmappedWrite  = 1,
+    kGBDiagnosticPortRead       = 2, // I/O port with nothing installed
+    kGBDiagnosticPortWrite      = 3,
+    kGBDiagnosticPortRange      = 4, // I/O mapper asked for an address outside of it
+    kGBDiagnosticROMWrite       = 5, // Cart ROM without a mapper
+    kGBDiagnosticBIOSWrite      = 6,
+
+    kGBDiagnosticCount          = 7
+};
+
+// Count one access. Logs to stderr the first time this address is hit for this kind (unless the kind is quiet).
+void GBDiagnosticsRecord(uint8_t kind, uint16_t address);
+
+// Accesses counted for a kind, and how many different addresses they touched
+uint64_t GBDiagnosticsCount(uint8_t kind);
+uint32_t GBDiagnosticsAddressCount(uint8_t kind);
+
+// Print every kind that has been counted
+void GBDiagnosticsDump(FILE *stream);
+
+// Zero the counters and forget which addresses have been logged
+void GBDiagnosticsReset(void);
+
+#endif /* !defined(__LIBGB_DIAG__) */
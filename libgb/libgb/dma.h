@@ -7,9 +7,15 @@
 #define kGBDMARegisterAddress       0xFF46
 #define kGBDMARegisterInitClocks    4
 #define kGBDMARegisterTotalClocks   (160 * 4) + kGBDMARegisterInitClocks
+#define kGBDMARegisterLength        0xA0
+
+// The bus is given back on the first byte tick after the last byte has moved
+#define kGBDMARegisterEndClocks     (kGBDMARegisterTotalClocks + 4)
 
 struct __GBProcessor;
 struct __GBGameboy;
+struct __GBClock;
+struct __GBSpriteRAM;
 
 typedef struct  __GBDMARegister {
     uint16_t address; // 0xFF46
@@ -28,9 +34,20 @@ typedef struct  __GBDMARegister {
 
     bool (*install)(struct __GBDMARegister *this, struct __GBGameboy *gameboy);
     void (*tick)(struct __GBDMARegister *this, uint64_t ticks);
+    uint64_t (*nextEvent)(struct __GBDMARegister *this, uint64_t ticks);
+
+    // The clock only runs us when a byte is due, so we keep track of the ticks in between.
+    uint64_t lastTick;
+    bool paused;
+
+    // Copy all 160 bytes when the transfer ends instead of one every 4 ticks (on for the fast cores).
+    // Only high RAM is reachable while the bus is locked, so nothing can tell the difference.
+    bool bulk;
 
     // For CPU state and MMU
     struct __GBProcessor *cpu;
+    struct __GBClock *clock;
+    struct __GBSpriteRAM *oam;
 } GBDMARegister;
 
 GBDMARegister *GBDMARegisterCreate(void);
@@ -40,5 +57,6 @@ void __GBDMARegisterWrite(GBDMARegister *this, uint8_t byte);
 
 bool __GBDMARegisterInstall(GBDMARegister *this, struct __GBGameboy *gameboy);
 void __GBDMARegisterTick(GBDMARegister *this, uint64_t ticks);
+uint64_t __GBDMARegisterNextEvent(GBDMARegister *this, uint64_t ticks);
 
 #endif /* !defined(__LIBGB_DMA__) */
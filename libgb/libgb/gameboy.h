@@ -2,13 +2,17 @@
 #define __LIBGB__ 1
 
 #include <libgb/apu.h>
+#include <libgb/arena.h>
 #include <libgb/bios.h>
 #include <libgb/cart.h>
 #include <libgb/cpu.h>
+#include <libgb/diag.h>
 #include <libgb/dma.h>
 #include <libgb/mmio.h>
 #include <libgb/mmu.h>
 #include <libgb/lcd.h>
+#include <libgb/shade.h>
+#include <libgb/tile.h>
 #include <libgb/wram.h>
 #include <libgb/clock.h>
 #include <libgb/gamepad.h>
@@ -22,6 +26,14 @@
 // buttons
 // link cable? not really necessary tho...
 
+struct __GBGameboy;
+
+// Changes to a save file are flushed about once a second of emulated time while running
+#define kGBGameboySaveFlushTicks 4194304
+
+// Called before each instruction while running. Returning false stops the run before the instruction.
+typedef bool (*GBGameboyInstructionHook)(struct __GBGameboy *gameboy, void *context);
+
 typedef struct __GBGameboy {
     GBProcessor *cpu;
     GBIOMapper *mmio;
@@ -37,9 +49,30 @@ typedef struct __GBGameboy {
 
     GBBIOSROM *bios;
     bool biosInstalled;
+
+    // Only used while running through GBGameboyRunCycles and GBGameboyRunFrame
+    GBGameboyInstructionHook instructionHook;
+    void *hookContext;
+
+    uint64_t saveFlushTick; // When cart RAM was last flushed to its save file
+
+    GBArena *arena; // Everything above was allocated from here (NULL if it was malloced)
 } GBGameboy;
 
 GBGameboy *GBGameboyCreate(void);
+GBGameboy *GBGameboyCreateWithCore(uint8_t core);
+
+// Allocate the whole machine in one cache line aligned block (see arena.h)
+GBGameboy *GBGameboyCreateInArena(uint8_t core);
+
+// The cartridge and BIOS belong to the caller and aren't destroyed
+void GBGameboyDestroy(GBGameboy *this);
+
+// A machine made in an arena can be snapshotted with a single copy, plus the cartridge's mapper, clock and RAM.
+// The snapshot can only be restored into the same machine, with the same cartridge and BIOS (restoring returns false otherwise).
+size_t GBGameboySnapshotSize(GBGameboy *this);
+bool GBGameboySnapshot(GBGameboy *this, void *buffer);
+bool GBGameboyRestoreSnapshot(GBGameboy *this, const void *buffer);
 
 bool GBGameboyIsPoweredOn(GBGameboy *this);
 void GBGameboyPowerOff(GBGameboy *this);
@@ -51,6 +84,24 @@ void GBGameboyMaskBIOS(GBGameboy *this, GBBIOSROM *bios);
 bool GBGameboyInsertCartridge(GBGameboy *this, GBCartridge *cart);
 bool GBGameboyEjectCartridge(GBGameboy *this, GBCartridge *cart);
 
+// Run for exactly `cycles` clock ticks. Returns the number of ticks run.
+// This is fewer when the instruction hook stops the run or the console is turned off.
+// Both run functions flush changed save RAM every kGBGameboySaveFlushTicks.
+uint64_t GBGameboyRunCycles(GBGameboy *this, uint64_t cycles);
+
+// Run until the driver enters vblank, or for as long as a frame takes with the display off. Returns the number of ticks run.
+uint64_t GBGameboyRunFrame(GBGameboy *this);
+
+// Set (or clear with NULL) the function called before each instruction by the run functions.
+// Running with a hook steps the clock one instruction at a time, so leave it unset when it isn't needed.
+void GBGameboySetInstructionHook(GBGameboy *this, GBGameboyInstructionHook hook, void *context);
+
+// Translate hot cartridge code for the fast cores (see jit.h). Returns false if it can't be turned on.
+bool GBGameboySetJITEnabled(GBGameboy *this, bool enabled);
+
+// Check every translated block against the interpreter (slow, see jit.h). Returns false if the JIT hasn't been turned on.
+bool GBGameboySetJITVerify(GBGameboy *this, bool verify);
+
 #endif /* !defined(__LIBGB__) */
 
 // "internal" clock will run at 4 khz
@@ -30,6 +30,10 @@ typedef struct __GBGamepad {
     bool pressed[2][4];
 
     uint8_t *interruptFlag;
+
+    // Key presses wake the processor from halt and stop
+    struct __GBGameboy *gameboy;
+
     bool (*install)(struct __GBGamepad *this, struct __GBGameboy *gameboy);
 } GBGamepad;
 
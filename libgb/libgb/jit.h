@@ -0,0 +1,82 @@
+#ifndef __LIBGB_JIT__
+#define __LIBGB_JIT__ 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+struct __GBProcessor;
+struct __GBCartROM;
+
+// The JIT translates basic blocks of cartridge ROM into x86-64 code for the fast processor cores.
+// Blocks are found by ROM bank and PC. Translated code runs whole instructions until something else is due,
+// and leaves anything it can't do (RAM code, the BIOS, I/O and ROM writes, halt, ei/di) to the interpreter.
+// On other hosts GBProcessorJITCreate returns NULL and the interpreter runs everything.
+#if defined(__x86_64__) && !defined(_WIN32)
+    #define kGBJITAvailable 1
+#else /* !(defined(__x86_64__) && !defined(_WIN32)) */
+    #define kGBJITAvailable 0
+#endif /* defined(__x86_64__) && !defined(_WIN32) */
+
+#define kGBJITCodeSize          0x400000    // 4 MB of host code before everything is flushed
+#define kGBJITBlockSize         0x2000      // Room left for one block before we flush
+#define kGBJITInstructionSize   0x100       // The most host code one instruction and the exit after it take up
+#define kGBJITBlockCount        0x8000
+#define kGBJITBucketCount       0x1000
+#define kGBJITMaxInstructions   64
+
+// A block never runs longer than this. It keeps the processor's cycle count in range when nothing else is scheduled.
+#define kGBJITMaxBudget         0x4000
+
+// In verify mode blocks are kept short enough for every write to fit in the undo log.
+#define kGBJITVerifyBudget      0x100
+#define kGBJITUndoLogSize       0x100
+
+// Returns the number of instructions run. The processor's PC and cycle count are up to date on return.
+typedef uint32_t (*GBJITBlockCode)(struct __GBProcessor *cpu, uint32_t budget);
+
+typedef struct __GBJITBlock {
+    uint32_t key; // ROM bank << 16 | PC
+    GBJITBlockCode code; // NULL when the first instruction can't be translated
+
+    struct __GBJITBlock *next;
+} GBJITBlock;
+
+typedef struct {
+    uint16_t address;
+    uint8_t value;
+} GBJITUndoEntry;
+
+typedef struct __GBProcessorJIT {
+    struct __GBCartROM *rom;
+
+    bool enabled;
+    bool verify; // Check every block against the interpreter (slow)
+
+    uint8_t *code;
+    size_t codeUsed;
+
+    GBJITBlock *blocks;
+    uint32_t blockCount;
+    GBJITBlock *buckets[kGBJITBucketCount];
+
+    GBJITUndoEntry undo[kGBJITUndoLogSize];
+    uint16_t undoCount;
+
+    uint64_t compiled;      // Blocks translated
+    uint64_t entered;       // Times translated code ran
+    uint64_t instructions;  // Instructions run by translated code
+    uint64_t fallbacks;     // Fetches left to the interpreter
+    uint64_t mismatches;    // Blocks which didn't match the interpreter (verify mode)
+} GBProcessorJIT;
+
+GBProcessorJIT *GBProcessorJITCreate(void);
+void GBProcessorJITDestroy(GBProcessorJIT *this);
+
+// Throw away every translated block (the ROM changed)
+void GBProcessorJITFlush(GBProcessorJIT *this);
+
+// Run translated code from the current PC. Returns false if the interpreter has to run the next instruction.
+bool GBProcessorJITRun(GBProcessorJIT *this, struct __GBProcessor *cpu);
+
+#endif /* !defined(__LIBGB_JIT__) */
@@ -1,6 +1,8 @@
 #ifndef __LIBGB_PPU__
 #define __LIBGB_PPU__ 1
 
+#include <libgb/shade.h>
+#include <libgb/tile.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -17,6 +19,11 @@
 #define kGBVideoRAMEnd          0x9FFF
 #define kGBVideoRAMSize         0x2000
 
+// Tile data is the first 0x1800 bytes. Tiles are numbered from 0x8000.
+#define kGBVideoRAMTileCount    384
+#define kGBVideoRAMTileBytes    (8 * kGBTileRowBytes)
+#define kGBVideoRAMTilePixels   (8 * kGBTileRowPixels)
+
 struct __GBGraphicsDriver;
 struct __GBGameboy;
 
@@ -31,11 +38,24 @@ typedef struct __GBVideoRAM {
 
     uint8_t memory[kGBVideoRAMSize];
     struct __GBGraphicsDriver *driver;
+
+    // Tile data decoded to color indices. Writes that change a tile set its bit, and it is decoded again when next used.
+    uint8_t tiles[kGBVideoRAMTileCount][kGBVideoRAMTilePixels];
+    uint32_t dirtyTiles[kGBVideoRAMTileCount / 32];
 } GBVideoRAM;
 
 GBVideoRAM *GBVideoRAMCreate(void);
 void GBVideoRAMDestroy(GBVideoRAM *this);
 
+// The 8 rows of 8 color indices for a tile
+const uint8_t *GBVideoRAMTile(GBVideoRAM *this, uint16_t index);
+
+// Decode every tile that has changed (for something about to look at all of them)
+void GBVideoRAMUpdateTiles(GBVideoRAM *this);
+
+// Only needed after changing `memory` without going through the memory manager
+void GBVideoRAMInvalidateTiles(GBVideoRAM *this);
+
 void __GBVideoRAMWrite(GBVideoRAM *this, uint16_t address, uint8_t byte);
 uint8_t __GBVideoRAMRead(GBVideoRAM *this, uint16_t address);
 
@@ -129,16 +149,6 @@ typedef struct __GBCoordPort {
 GBCoordPort *GBCoordPortCreate(void);
 void __GBCoordPortWrite(GBCoordPort *this, uint8_t byte);
 
-typedef struct __GBVideoPortGeneric {
-    uint16_t address;
-
-    void (*write)(struct __GBVideoPortGeneric *this, uint8_t byte);
-    uint8_t (*read)(struct __GBVideoPortGeneric *this);
-
-    uint8_t value;
-} GBVideoPortGeneric;
-
-GBVideoPortGeneric *GBVideoPortGenericCreate(uint16_t address);
 
 #pragma mark - LCD Driver
 
@@ -163,10 +173,14 @@ GBVideoPortGeneric *GBVideoPortGenericCreate(uint16_t address);
 
 #define kGBCoordinateMaxY               153
 
+#define kGBDriverDamageWords            ((kGBScreenHeight + 31) / 32)
+
 #define kGBDriverSpriteSearchClocks     80
+#define kGBDriverPixelTransferClocks    175 // Without fine scroll. The scanline renderer adds (scrollX % 8).
 #define kGBDriverHorizonalClocks        376
 //#define kGBDriverVerticalClocks         4560
 #define kGBDriverVerticalClockUpdate    456
+#define kGBDriverFrameClocks            (kGBDriverVerticalClockUpdate * (kGBCoordinateMaxY + 1))
 
 #define kGBVideoInterruptOnLine         (1 << 6)
 #define kGBVideoInterruptSpriteSearch   (1 << 5)
@@ -192,18 +206,21 @@ enum {
 typedef struct __GBGraphicsDriver {
     bool (*install)(struct __GBGraphicsDriver *this, struct __GBGameboy *gameboy);
     void (*tick)(struct __GBGraphicsDriver *this, uint64_t tick);
+    uint64_t (*nextEvent)(struct __GBGraphicsDriver *this, uint64_t tick);
 
     GBLCDControlPort *control;
     GBLCDStatusPort *status;
-    GBVideoPortGeneric *scrollX;
-    GBVideoPortGeneric *scrollY;
     GBCoordPort *coordinate;
-    GBVideoPortGeneric *compare;
-    GBVideoPortGeneric *windowX;
-    GBVideoPortGeneric *windowY;
-    GBVideoPortGeneric *paletteBG;
-    GBVideoPortGeneric *paletteSprite0;
-    GBVideoPortGeneric *paletteSprite1;
+
+    // Plain registers in the I/O register file (set on install)
+    uint8_t *scrollX;
+    uint8_t *scrollY;
+    uint8_t *compare;
+    uint8_t *windowX;
+    uint8_t *windowY;
+    uint8_t *paletteBG;
+    uint8_t *paletteSprite0;
+    uint8_t *paletteSprite1;
 
     GBVideoRAM *vram;
     GBSpriteRAM *oam;
@@ -212,9 +229,21 @@ typedef struct __GBGraphicsDriver {
     bool displayOn;
 
     uint32_t screenData[kGBScreenHeight * kGBScreenWidth];
+
+    // Draw shades (kGBShadeWhite --> kGBShadeBlack) here instead of colors to screenData, which is left alone.
+    // Colors are only made by converting the screen. Damage is tracked for whichever buffer is being drawn to.
+    bool indexed;
+    uint8_t screenIndices[kGBScreenHeight * kGBScreenWidth];
+
     uint32_t *linePointer; // Points to the head of the current line while drawing
     uint32_t linePosition; // Offset into current line to place the next pixel
 
+    // Lines of screenData that changed since the damage was last taken (bit (n % 32) of word (n / 32) is line n).
+    // Pixels are compared as they're drawn, so a line redrawn with the same colors isn't damaged.
+    // A line is marked when it's finished, so one caught half drawn shows up the next time.
+    uint32_t damage[kGBDriverDamageWords];
+    uint32_t lineChanges; // Old pixel XOR new pixel (or shade) for everything drawn on the current line so far
+
     uint32_t colorLookup[4]; // Map of 'white, light, dark, black' to real RGB values.
     uint8_t nullColor; // The screen buffer is flushed with this value when it is disabled.
 
@@ -242,15 +271,44 @@ typedef struct __GBGraphicsDriver {
 
     uint16_t driverModeTicks; // Ticks in the current mode
     uint8_t driverMode; // The current driver mode
+    uint64_t lastTick; // The last clock tick the driver ran on (kGBClockNever once the display is turned on). Ticks skipped since then are made up in blanking modes.
+    uint64_t frameCount; // Times the driver has entered vblank
 
     uint8_t lineMod8; // Tracks the current line number mod 8. This is used to fetch the right lines of tiles.
     uint8_t driverX; // Track effective position for scrollX and windowX
+
+    // Draw each line in one go when pixel transfer ends instead of running the FIFO on every tick.
+    // Mode, LY and STAT timing still run as normal. Registers are read once per line (instead of once per pixel).
+    bool scanline;
+    bool scanlineNext; // Takes over from scanline at the next hblank (see GBGraphicsDriverSetScanline)
+    uint16_t transferClocks; // Length of pixel transfer on this line (scanline mode)
+    uint8_t windowLine; // The next line of the window to draw. Only lines the window was drawn on count.
 } GBGraphicsDriver;
 
 GBGraphicsDriver *GBGraphicsDriverCreate(void);
 void GBGraphicsDriverDestroy(GBGraphicsDriver *this);
 
+// Switch between the scanline and per-dot renderers. The two keep different state in the middle of a line,
+// so while the display is drawing one the switch waits for hblank.
+void GBGraphicsDriverSetScanline(GBGraphicsDriver *this, bool enabled);
+
+// Whether a line has changed since the damage was last taken
+bool GBGraphicsDriverLineDamaged(GBGraphicsDriver *this, uint8_t line);
+
+// Copy out and clear the damaged lines. Returns false if nothing changed.
+bool GBGraphicsDriverTakeDamage(GBGraphicsDriver *this, uint32_t damage[kGBDriverDamageWords]);
+
+// Mark every line damaged (for when whoever shows the screen has lost track of it)
+void GBGraphicsDriverDamageAll(GBGraphicsDriver *this);
+
+// Convert screenIndices (indexed mode) to colors, `pitch` bytes per line. Only lines set in `damage` are done, or every
+// line if it's NULL. A NULL lookup uses colorLookup, gGBShadeRGB565 or gGBShadeGray.
+void GBGraphicsDriverConvertScreen32(GBGraphicsDriver *this, const uint32_t damage[kGBDriverDamageWords], const uint32_t lookup[4], uint32_t *pixels, size_t pitch);
+void GBGraphicsDriverConvertScreen16(GBGraphicsDriver *this, const uint32_t damage[kGBDriverDamageWords], const uint16_t lookup[4], uint16_t *pixels, size_t pitch);
+void GBGraphicsDriverConvertScreen8(GBGraphicsDriver *this, const uint32_t damage[kGBDriverDamageWords], const uint8_t lookup[4], uint8_t *pixels, size_t pitch);
+
 bool __GBGraphicsDriverInstall(GBGraphicsDriver *this, struct __GBGameboy *gameboy);
 void __GBGraphicsDriverTick(GBGraphicsDriver *this, uint64_t ticks);
+uint64_t __GBGraphicsDriverNextEvent(GBGraphicsDriver *this, uint64_t ticks);
 
 #endif /* !defined(__LIBGB_PPU__) */
@@ -6,6 +6,7 @@
 
 #define kGBIOMapperFirstAddress 0xFF00
 #define kGBIOMapperFinalAddress 0xFF7F
+#define kGBIOMapperPortCount    ((kGBIOMapperFinalAddress - kGBIOMapperFirstAddress) + 1)
 
 struct __GBGameboy;
 
@@ -33,13 +34,22 @@ typedef struct __GBIOMapper {
     uint16_t startAddress;
     uint16_t endAddress;
 
-    GBIORegister *portMap[(kGBIOMapperFinalAddress - kGBIOMapperFirstAddress) + 1];
+    // Plain registers are bytes in `registers`. Addresses with a bit set in `readHooks` or `writeHooks`
+    // go through their port in `portMap` instead (ports with side effects, and the null ports).
+    uint8_t registers[kGBIOMapperPortCount];
+    uint32_t readHooks[kGBIOMapperPortCount / 32];
+    uint32_t writeHooks[kGBIOMapperPortCount / 32];
+
+    GBIORegister *portMap[kGBIOMapperPortCount];
 } GBIOMapper;
 
 GBIOMapper *GBIOMapperCreate(void);
 void GBIOMapperInstallPort(GBIOMapper *this, GBIORegister *port);
 void GBIOMapperDestroy(GBIOMapper *this);
 
+// Install a register with no side effects. Reads and writes are a load or store of the returned byte.
+uint8_t *GBIOMapperInstallRegister(GBIOMapper *this, uint16_t address, uint8_t value);
+
 // These call through into the ports
 void __GBIOMapperWrite(GBIOMapper *this, uint16_t address, uint8_t byte);
 uint8_t __GBIOMapperRead(GBIOMapper *this, uint16_t address);
@@ -3,6 +3,7 @@
 
 #include <libgb/mmio.h>
 #include <libgb/wram.h>
+#include <libgb/decode.h>
 
 // Note: There isn't really an mmu in a real gameboy.
 // addresses are calculated internally without the flexibility an mmu would provide
@@ -34,6 +35,12 @@
 #define kGBMemoryBankSize 0x1000
 #define kGBMemoryBankMask 0xF000
 
+// Plain memory is also mapped into a table of 256-byte pages.
+// A page with a host pointer is accessed directly, a NULL page goes through its space (MMIO, VRAM, OAM, unmapped).
+#define kGBMemoryPageShift 8
+#define kGBMemoryPageSize  (1 << kGBMemoryPageShift)
+#define kGBMemoryPageCount (0x10000 >> kGBMemoryPageShift)
+
 struct __GBGameboy;
 
 typedef struct __GBMemorySpace {
@@ -58,6 +65,14 @@ typedef struct __GBMemoryManager {
     GBMemorySpace *romSpace;
     bool *romMasked;
 
+    // Host memory behind each page (NULL if the page has to go through its space)
+    uint8_t *readPages[kGBMemoryPageCount];
+    uint8_t *writePages[kGBMemoryPageCount];
+
+    // The BIOS lies over page 0 until it is masked. The cart's page 0 is kept here meanwhile.
+    uint8_t *biosPage;
+    uint8_t *cartPage;
+
     uint8_t *interruptControl;
     bool *dma;
 
@@ -66,22 +81,47 @@ typedef struct __GBMemoryManager {
     bool *accessed;
     bool isWrite;
 
+    bool busWritten; // Set when a request is serviced outside of tick() so the clock knows to let other hardware look again
+
+    // The processor accesses memory with GBMemoryManagerBusRead/Write instead of making requests (fast cores only)
+    bool synchronous;
+
+    // Lines of memory the processor has cached code from (NULL if it doesn't cache). Writing to one sets codeWritten.
+    uint8_t *codeMap;
+    bool codeWritten;
+
     void (*tick)(struct __GBMemoryManager *this, uint64_t tick);
+    uint64_t (*nextEvent)(struct __GBMemoryManager *this, uint64_t tick);
 } GBMemoryManager;
 
 GBMemoryManager *GBMemoryManagerCreate(void);
 bool GBMemoryManagerInstallSpace(GBMemoryManager *this, GBMemorySpace *space);
+
+// Point the pages from start --> end at host memory. Either pointer may be NULL to leave that access to the space.
+void GBMemoryManagerMapPages(GBMemoryManager *this, uint16_t start, uint16_t end, uint8_t *read, uint8_t *write);
+void GBMemoryManagerUnmapPages(GBMemoryManager *this, uint16_t start, uint16_t end);
+
+// Lay the BIOS over page 0 (or take it away if data is NULL)
+void GBMemoryManagerMapBIOS(GBMemoryManager *this, uint8_t *data);
 void GBMemoryManagerDestroy(GBMemoryManager *this);
 
 // Call through to proper space. Access will take place on memory line tick.
 void GBMemoryManagerWriteRequest(GBMemoryManager *this, uint16_t *mar, uint8_t *mdr, bool *accessed);
 void GBMemoryManagerReadRequest(GBMemoryManager *this, uint16_t *mar, uint8_t *mdr, bool *accessed);
 
+// Service a pending request right away instead of waiting for the next memory line tick.
+void GBMemoryManagerService(GBMemoryManager *this);
+
+// Access memory right away without a request. DMA restrictions apply as they would to a request.
+void GBMemoryManagerBusWrite(GBMemoryManager *this, uint16_t address, uint8_t byte);
+uint8_t GBMemoryManagerBusRead(GBMemoryManager *this, uint16_t address);
+
 // Directly accesses memory. For use in tick().
 void __GBMemoryManagerWrite(GBMemoryManager *this, uint16_t address, uint8_t byte);
 uint8_t __GBMemoryManagerRead(GBMemoryManager *this, uint16_t address);
 
 void __GBMemoryManagerTick(GBMemoryManager *this, uint64_t tick);
+uint64_t __GBMemoryManagerNextEvent(GBMemoryManager *this, uint64_t tick);
 
 extern GBMemorySpace *gGBMemorySpaceNull;
 
@@ -0,0 +1,25 @@
+#ifndef __LIBGB_SHADE__
+#define __LIBGB_SHADE__ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A shade is one of the 4 colors the screen can show after the palettes have been applied.
+// Converting a buffer of shades looks each one up in a 4 entry table of whatever pixel format is wanted.
+
+#define kGBShadeWhite       0
+#define kGBShadeLight       1
+#define kGBShadeDark        2
+#define kGBShadeBlack       3
+
+// The default gray levels as RGB565 and 8-bit gray
+extern const uint16_t gGBShadeRGB565[4];
+extern const uint8_t gGBShadeGray[4];
+
+// Convert `count` shades. Only the low 2 bits of each shade are used.
+// These use SSE2 when the compiler has it, 16 shades at a time.
+void GBShadeConvert32(const uint8_t *shades, size_t count, const uint32_t lookup[4], uint32_t *pixels);
+void GBShadeConvert16(const uint8_t *shades, size_t count, const uint16_t lookup[4], uint16_t *pixels);
+void GBShadeConvert8(const uint8_t *shades, size_t count, const uint8_t lookup[4], uint8_t *pixels);
+
+#endif /* !defined(__LIBGB_SHADE__) */
@@ -0,0 +1,20 @@
+#ifndef __LIBGB_TILE__
+#define __LIBGB_TILE__ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Tile data is stored a row at a time, two bytes per row. The first byte has the low bit of each pixel's color
+// and the second has the high bit, with the leftmost pixel in bit 7. Decoding a row gives 8 color indices (0-3).
+
+#define kGBTileRowBytes     2
+#define kGBTileRowPixels    8
+
+// Decode one row
+void GBTileDecodeRow(uint8_t low, uint8_t high, uint8_t pixels[kGBTileRowPixels]);
+
+// Decode `count` rows stored back to back (the way they sit in video RAM) into 8 indices each.
+// Uses AVX2 or SSE2 when the compiler has them, and a plain 64-bit version otherwise.
+void GBTileDecodeRows(const uint8_t *data, size_t count, uint8_t *pixels);
+
+#endif /* !defined(__LIBGB_TILE__) */
@@ -0,0 +1,104 @@
+#include <libgb/alu.h>
+
+uint16_t gGBALUAdd[2][0x10000];
+uint16_t gGBALUSub[2][0x10000];
+uint16_t gGBALUDecimalAdjust[0x800];
+uint16_t gGBALUShift[kGBALUShiftCount][2][0x100];
+
+static uint16_t __GBALUEntry(uint8_t result, bool n, bool h, bool c)
+{
+    uint8_t flags = (!result) ? kGBFlagZero : 0;
+
+    if (n) flags |= kGBFlagSubtract;
+    if (h) flags |= kGBFlagHalfCarry;
+    if (c) flags |= kGBFlagCarry;
+
+    return (result << 8) | flags;
+}
+
+#pragma mark - Arithmetic
+
+static void __GBALUArithmeticInit(void)
+{
+    for (uint8_t carry = 0; carry < 2; carry++)
+    {
+        for (uint32_t i = 0; i < 0x10000; i++)
+        {
+            uint8_t left = i >> 8;
+            uint8_t right = i & 0xFF;
+
+            // Two 4-bit adds (this is how the gameboy actually does this)
+            uint8_t sum = left + right + carry;
+            bool halfCarry = ((left & 0xF) + (right & 0xF) + carry) >> 4;
+
+            gGBALUAdd[carry][i] = __GBALUEntry(sum, false, halfCarry, (left + right + carry) >> 8);
+
+            uint8_t difference = left + (~right + 1) - (~carry + 1);
+            bool halfBorrow = !!(((left & 0x0F) + ((~right + 1) & 0x0F)) & 0x08);
+
+            gGBALUSub[carry][i] = __GBALUEntry(difference, true, halfBorrow, difference >> 7);
+        }
+    }
+}
+
+static void __GBALUDecimalAdjustInit(void)
+{
+    for (uint16_t i = 0; i < 0x800; i++)
+    {
+        uint8_t a = i & 0xFF;
+        bool n = (i >> 10) & 1;
+        bool h = (i >> 9) & 1;
+        bool c = (i >> 8) & 1;
+
+        if (n) {
+            if (c)
+                a -= 0x60;
+
+            if (h)
+                a -= 0x06;
+        } else {
+            if (c || a > 0x99)
+            {
+                a += 0x60;
+                c = 1;
+            }
+
+            if (h || (a & 0x0F) > 0x09)
+                a += 0x06;
+        }
+
+        gGBALUDecimalAdjust[i] = __GBALUEntry(a, n, false, c);
+    }
+}
+
+#pragma mark - Rotates and Shifts
+
+static void __GBALUShiftInit(void)
+{
+    for (uint8_t carry = 0; carry < 2; carry++)
+    {
+        for (uint16_t i = 0; i < 0x100; i++)
+        {
+            uint8_t value = i;
+
+            gGBALUShift[kGBALUShiftRLC][carry][i]  = __GBALUEntry((value << 1) | (value >> 7), false, false, value >> 7);
+            gGBALUShift[kGBALUShiftRRC][carry][i]  = __GBALUEntry((value << 7) | (value >> 1), false, false, value & 1);
+            gGBALUShift[kGBALUShiftRL][carry][i]   = __GBALUEntry((value << 1) | carry, false, false, value >> 7);
+            gGBALUShift[kGBALUShiftRR][carry][i]   = __GBALUEntry((value >> 1) | (carry << 7), false, false, value & 1);
+            gGBALUShift[kGBALUShiftSLA][carry][i]  = __GBALUEntry(value << 1, false, false, value >> 7);
+            gGBALUShift[kGBALUShiftSRA][carry][i]  = __GBALUEntry((value >> 1) | (value & 0x80), false, false, value & 1);
+            gGBALUShift[kGBALUShiftSwap][carry][i] = __GBALUEntry((value >> 4) | (value << 4), false, false, false);
+            gGBALUShift[kGBALUShiftSRL][carry][i]  = __GBALUEntry(value >> 1, false, false, value & 1);
+        }
+    }
+}
+
+#pragma mark - Tables
+
+// Filled in at load time, so machines can be created on any thread without racing to do it
+__attribute__((constructor)) static void __GBALUTablesInit(void)
+{
+    __GBALUArithmeticInit();
+    __GBALUDecimalAdjustInit();
+    __GBALUShiftInit();
+}
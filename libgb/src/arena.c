@@ -0,0 +1,104 @@
+#include <libgb/arena.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+static _Thread_local GBArena *gGBArenaCurrent = NULL;
+
+#pragma mark - Arena Structure
+
+GBArena *GBArenaCreate(size_t size)
+{
+    GBArena *arena = malloc(sizeof(GBArena));
+
+    if (arena)
+    {
+        // Anonymous memory is zeroed, page aligned, and only backed once it's touched
+        arena->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+
+        if (arena->base == MAP_FAILED)
+        {
+            free(arena);
+
+            return NULL;
+        }
+
+        arena->size = size;
+        arena->used = 0;
+    }
+
+    return arena;
+}
+
+void GBArenaDestroy(GBArena *this)
+{
+    if (gGBArenaCurrent == this)
+        gGBArenaCurrent = NULL;
+
+    munmap(this->base, this->size);
+    free(this);
+}
+
+void GBArenaTrim(GBArena *this)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t keep = (this->used + page - 1) & ~(page - 1);
+
+    if (keep < this->size)
+    {
+        munmap(this->base + keep, this->size - keep);
+
+        this->size = keep;
+    }
+
+    this->used = this->size;
+}
+
+bool GBArenaContains(GBArena *this, const void *pointer)
+{
+    const uint8_t *address = pointer;
+
+    return (address >= this->base && address < (this->base + this->size));
+}
+
+#pragma mark - Allocation
+
+void GBArenaSetCurrent(GBArena *arena)
+{
+    gGBArenaCurrent = arena;
+}
+
+GBArena *GBArenaGetCurrent(void)
+{
+    return gGBArenaCurrent;
+}
+
+void *GBAllocate(size_t size)
+{
+    GBArena *arena = gGBArenaCurrent;
+
+    if (!arena)
+        return malloc(size);
+
+    size_t start = (arena->used + (kGBArenaAlignment - 1)) & ~((size_t)kGBArenaAlignment - 1);
+
+    if (start > arena->size || size > (arena->size - start))
+    {
+        fprintf(stderr, "Error: Machine arena is full! (%zu bytes wanted, %zu left)\n", size, arena->size - arena->used);
+
+        return NULL;
+    }
+
+    arena->used = start + size;
+
+    return arena->base + start;
+}
+
+void GBRelease(void *pointer)
+{
+    if (gGBArenaCurrent && GBArenaContains(gGBArenaCurrent, pointer))
+        return;
+
+    free(pointer);
+}
@@ -26,8 +26,13 @@ GBBIOSMaskPort *GBBIOSMaskPortCreate(GBBIOSROM *bios)
 void __GBBIOSMaskPortWrite(GBBIOSMaskPort *port, uint8_t byte)
 {
     if (!port->bios->masked && byte)
+    {
         port->bios->masked = true;
 
+        if (port->bios->mmu)
+            GBMemoryManagerMapBIOS(port->bios->mmu, NULL);
+    }
+
     port->value = byte;
 }
 
@@ -55,6 +60,7 @@ GBBIOSROM *GBBIOSROMCreate(uint8_t data[kGBBIOSROMSize])
 
         bios->port = GBBIOSMaskPortCreate(bios);
         bios->masked = false;
+        bios->mmu = NULL;
 
         if (!bios->port)
         {
@@ -76,6 +82,10 @@ bool __GBBIOSROMOnInstall(GBBIOSROM *this, GBGameboy *gameboy)
 {
     gameboy->cpu->mmu->romSpace = (GBMemorySpace *)this;
     gameboy->cpu->mmu->romMasked = &this->masked;
+    this->mmu = gameboy->cpu->mmu;
+
+    if (!this->masked)
+        GBMemoryManagerMapBIOS(this->mmu, this->data);
 
     GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->port);
     return true;
@@ -83,7 +93,7 @@ bool __GBBIOSROMOnInstall(GBBIOSROM *this, GBGameboy *gameboy)
 
 void __GBBIOSROMWrite(GBBIOSROM *this, uint16_t address, uint8_t byte)
 {
-    fprintf(stderr, "Warning: Write to BIOS ROM! (addr=0x%04X, byte=0x%02X)\n", address, byte);
+    GBDiagnosticsRecord(kGBDiagnosticBIOSWrite, address);
 }
 
 uint8_t __GBBIOSROMRead(GBBIOSROM *this, uint16_t address)
@@ -1,5 +1,9 @@
 #include <libgb/gameboy.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <stdlib.h>
+#include <fcntl.h>
 #include <stdio.h>
 
 #ifdef __APPLE__
@@ -8,21 +12,14 @@
 
 #pragma mark - ROM Structure
 
-GBCartROM *GBCartROMCreateGeneric(uint8_t *romData, uint8_t banks, uint8_t (*readFunc)(struct __GBCartROM *this, uint16_t address), void (*writeFunc)(struct __GBCartROM *this, uint16_t address, uint8_t byte))
+static GBCartROM *__GBCartROMCreate(uint8_t *romData, uint16_t banks, bool shared, uint8_t (*readFunc)(struct __GBCartROM *this, uint16_t address), void (*writeFunc)(struct __GBCartROM *this, uint16_t address, uint8_t byte))
 {
     GBCartROM *rom = malloc(sizeof(GBCartROM));
-    uint16_t bankSize = kGBMemoryBankSize * 4;
 
     if (rom)
     {
-        rom->romData = malloc(banks * bankSize);
-
-        if (!rom->romData) {
-            free(rom);
-            return NULL;
-        } else {
-            memcpy(rom->romData, romData, banks * bankSize);
-        }
+        rom->romData = romData;
+        rom->shared = shared;
 
         rom->install = GBCartROMOnInstall;
         rom->eject = GBCartROMOnEject;
@@ -34,7 +31,18 @@ GBCartROM *GBCartROMCreateGeneric(uint8_t *romData, uint8_t banks, uint8_t (*rea
         rom->end = kGBCartROMBankHighEnd;
 
         rom->maxBank = banks;
-        rom->bank = 1;
+        rom->mmu = NULL;
+        rom->ram = NULL;
+
+        rom->bankSelect = 1;
+        rom->bankHigh = 0;
+        rom->bankMode = false;
+        rom->ramEnabled = false;
+
+        rom->lowBank = 0;
+        rom->bank = 1 % banks;
+        rom->lowStart = romData;
+        rom->bankStart = romData + (rom->bank * (kGBMemoryBankSize * 4));
 
         rom->installed = false;
     }
@@ -42,54 +50,211 @@ GBCartROM *GBCartROMCreateGeneric(uint8_t *romData, uint8_t banks, uint8_t (*rea
     return rom;
 }
 
-GBCartROM *GBCartROMCreateWithNullMapper(uint8_t *romData, uint8_t banks)
+GBCartROM *GBCartROMCreateGeneric(uint8_t *romData, uint16_t banks, uint8_t (*readFunc)(struct __GBCartROM *this, uint16_t address), void (*writeFunc)(struct __GBCartROM *this, uint16_t address, uint8_t byte))
+{
+    uint32_t size = banks * (kGBMemoryBankSize * 4);
+    uint8_t *copy = malloc(size);
+
+    if (!copy)
+        return NULL;
+
+    memcpy(copy, romData, size);
+    GBCartROM *rom = __GBCartROMCreate(copy, banks, false, readFunc, writeFunc);
+
+    if (!rom)
+        free(copy);
+
+    return rom;
+}
+
+GBCartROM *GBCartROMCreateGenericShared(uint8_t *romData, uint16_t banks, uint8_t (*readFunc)(struct __GBCartROM *this, uint16_t address), void (*writeFunc)(struct __GBCartROM *this, uint16_t address, uint8_t byte))
+{
+    return __GBCartROMCreate(romData, banks, true, readFunc, writeFunc);
+}
+
+GBCartROM *GBCartROMCreateWithNullMapper(uint8_t *romData, uint16_t banks)
 {
     return GBCartROMCreateGeneric(romData, banks, GBCartROMReadBanked, GBCartROMWriteNull);
 }
 
-GBCartROM *GBCartROMCreateWithMBC1(uint8_t *romData, uint8_t banks)
+GBCartROM *GBCartROMCreateWithMBC1(uint8_t *romData, uint16_t banks)
 {
     return GBCartROMCreateGeneric(romData, banks, GBCartROMReadBanked, GBCartROMWriteMBC1);
 }
 
-GBCartROM *GBCartROMCreateWithMBC2(uint8_t *romData, uint8_t banks);
-
-GBCartROM *GBCartROMCreateWithMBC3(uint8_t *romData, uint8_t banks);
+GBCartROM *GBCartROMCreateWithMBC2(uint8_t *romData, uint16_t banks)
+{
+    return GBCartROMCreateGeneric(romData, banks, GBCartROMReadBanked, GBCartROMWriteMBC2);
+}
 
-GBCartROM *GBCartROMCreateWithMBC4(uint8_t *romData, uint8_t banks);
+GBCartROM *GBCartROMCreateWithMBC3(uint8_t *romData, uint16_t banks)
+{
+    return GBCartROMCreateGeneric(romData, banks, GBCartROMReadBanked, GBCartROMWriteMBC3);
+}
 
-GBCartROM *GBCartROMCreateWithMBC5(uint8_t *romData, uint8_t banks);
+GBCartROM *GBCartROMCreateWithMBC5(uint8_t *romData, uint16_t banks)
+{
+    return GBCartROMCreateGeneric(romData, banks, GBCartROMReadBanked, GBCartROMWriteMBC5);
+}
 
 void GBCartROMDestroy(GBCartROM *this)
 {
     if (this->installed)
         fprintf(stderr, "Warning: Cartridge ROM destroyed before cartridge successfully ejected!\n");
 
-    free(this->romData);
+    if (!this->shared)
+        free(this->romData);
+
     free(this);
 }
 
+#pragma mark - Mappers
+
 void GBCartROMWriteNull(GBCartROM *this, uint16_t address, uint8_t byte)
 {
-    fprintf(stderr, "Warning: Attempting to write directly to ROM! (addr=0x%04X, byte=0x%02X)\n", address, byte);
+    GBDiagnosticsRecord(kGBDiagnosticROMWrite, address);
+}
+
+static void __GBCartROMSelectRAM(GBCartROM *this, bool enabled, uint8_t bank)
+{
+    if (this->ram)
+        __GBCartRAMSelectBank(this->ram, enabled, bank);
 }
 
 void GBCartROMWriteMBC1(GBCartROM *this, uint16_t address, uint8_t byte)
 {
-    //
+    switch (address >> 13)
+    {
+        case 0: // 0x0000 --> 0x1FFF: RAM enable
+            this->ramEnabled = ((byte & 0x0F) == 0x0A);
+        break;
+        case 1: // 0x2000 --> 0x3FFF: Low 5 bits of ROM bank (0 selects 1)
+            this->bankSelect = (byte & 0x1F) ? (byte & 0x1F) : 1;
+        break;
+        case 2: // 0x4000 --> 0x5FFF: ROM bank bits 5-6 or RAM bank
+            this->bankHigh = byte & 0x03;
+        break;
+        case 3: // 0x6000 --> 0x7FFF: In mode 1 the high bits also bank 0x0000 and RAM
+            this->bankMode = byte & 0x01;
+        break;
+    }
+
+    uint16_t lowBank = this->bankMode ? (this->bankHigh << 5) : 0;
+
+    __GBCartROMSelectBanks(this, lowBank, (this->bankHigh << 5) | this->bankSelect);
+    __GBCartROMSelectRAM(this, this->ramEnabled, this->bankMode ? this->bankHigh : 0);
 }
 
-uint8_t GBCartROMReadBanked(GBCartROM *s, uint16_t address)
+void GBCartROMWriteMBC2(GBCartROM *this, uint16_t address, uint8_t byte)
 {
-    if (address <= kGBCartROMBankLowEnd) {
-        return s->romData[address];
+    // Only 0x0000 --> 0x3FFF is decoded. Address bit 8 picks the register.
+    if (address > kGBCartROMBankLowEnd)
+        return;
+
+    if (address & 0x0100) {
+        this->bankSelect = (byte & 0x0F) ? (byte & 0x0F) : 1;
+
+        __GBCartROMSelectBanks(this, 0, this->bankSelect);
     } else {
-        uint8_t *bankStart = s->romData + (s->bank * (kGBMemoryBankSize * 4));
+        this->ramEnabled = ((byte & 0x0F) == 0x0A);
 
-        return bankStart[address - 0x4000];
+        __GBCartROMSelectRAM(this, this->ramEnabled, 0);
     }
 }
 
+void GBCartROMWriteMBC3(GBCartROM *this, uint16_t address, uint8_t byte)
+{
+    switch (address >> 13)
+    {
+        case 0: // 0x0000 --> 0x1FFF: RAM (and clock) enable
+            this->ramEnabled = ((byte & 0x0F) == 0x0A);
+        break;
+        case 1: // 0x2000 --> 0x3FFF: ROM bank (0 selects 1)
+            this->bankSelect = (byte & 0x7F) ? (byte & 0x7F) : 1;
+        break;
+        case 2: // 0x4000 --> 0x5FFF: RAM bank 0-3, or clock register 0x08-0x0C
+            this->bankHigh = byte & 0x0F;
+        break;
+        case 3: // 0x6000 --> 0x7FFF: Clock latch
+            if (this->ram && this->ram->rtc)
+                GBCartRTCLatch(this->ram->rtc, byte);
+        break;
+    }
+
+    __GBCartROMSelectBanks(this, 0, this->bankSelect);
+
+    if (this->bankHigh < kGBCartRTCSeconds) {
+        __GBCartROMSelectRAM(this, this->ramEnabled, this->bankHigh & 0x03);
+    } else if (this->ram && this->ram->rtc) {
+        __GBCartRAMSelectClock(this->ram, this->ramEnabled, this->bankHigh);
+    } else {
+        __GBCartROMSelectRAM(this, false, 0);
+    }
+}
+
+void GBCartROMWriteMBC5(GBCartROM *this, uint16_t address, uint8_t byte)
+{
+    switch (address >> 12)
+    {
+        case 0x0:
+        case 0x1: // 0x0000 --> 0x1FFF: RAM enable
+            this->ramEnabled = (byte == 0x0A);
+        break;
+        case 0x2: // 0x2000 --> 0x2FFF: Low 8 bits of ROM bank (0 is allowed here)
+            this->bankSelect = (this->bankSelect & 0x100) | byte;
+        break;
+        case 0x3: // 0x3000 --> 0x3FFF: ROM bank bit 8
+            this->bankSelect = (this->bankSelect & 0xFF) | ((byte & 0x01) << 8);
+        break;
+        case 0x4:
+        case 0x5: // 0x4000 --> 0x5FFF: RAM bank
+            this->bankHigh = byte & 0x0F;
+        break;
+        default: break;
+    }
+
+    __GBCartROMSelectBanks(this, 0, this->bankSelect);
+    __GBCartROMSelectRAM(this, this->ramEnabled, this->bankHigh);
+}
+
+#pragma mark - Banking
+
+uint8_t GBCartROMReadBanked(GBCartROM *this, uint16_t address)
+{
+    if (address <= kGBCartROMBankLowEnd) {
+        return this->lowStart[address];
+    } else {
+        return this->bankStart[address - kGBCartROMBankHighStart];
+    }
+}
+
+void __GBCartROMSelectBanks(GBCartROM *this, uint16_t lowBank, uint16_t bank)
+{
+    // Bank bits past the end of the ROM aren't connected
+    lowBank %= this->maxBank;
+    bank %= this->maxBank;
+
+    if (lowBank == this->lowBank && bank == this->bank)
+        return;
+
+    this->lowBank = lowBank;
+    this->bank = bank;
+
+    this->lowStart = this->romData + (lowBank * (kGBMemoryBankSize * 4));
+    this->bankStart = this->romData + (bank * (kGBMemoryBankSize * 4));
+
+    __GBCartROMMapPages(this);
+}
+
+void __GBCartROMMapPages(GBCartROM *this)
+{
+    if (!this->mmu)
+        return;
+
+    GBMemoryManagerMapPages(this->mmu, kGBCartROMBankLowStart, kGBCartROMBankLowEnd, this->lowStart, NULL);
+    GBMemoryManagerMapPages(this->mmu, kGBCartROMBankHighStart, kGBCartROMBankHighEnd, this->bankStart, NULL);
+}
+
 bool GBCartROMOnInstall(GBCartROM *this, GBGameboy *gameboy)
 {
     if (this->installed)
@@ -97,7 +262,14 @@ bool GBCartROMOnInstall(GBCartROM *this, GBGameboy *gameboy)
 
     bool success = GBMemoryManagerInstallSpace(gameboy->cpu->mmu, (GBMemorySpace *)this);
 
-    if (success) this->installed = true;
+    if (success)
+    {
+        this->installed = true;
+        this->mmu = gameboy->cpu->mmu;
+
+        __GBCartROMMapPages(this);
+    }
+
     return success;
 }
 
@@ -108,29 +280,173 @@ bool GBCartROMOnEject(GBCartROM *this, GBGameboy *gameboy)
 
     bool success = GBCartMemGenericOnEject((GBMemorySpace *)this, gameboy);
 
-    if (success) this->install = false;
+    if (success) this->installed = false;
+    this->mmu = NULL;
+
     return success;
 }
 
+#pragma mark - Clock Structure
+
+#define kGBCartRTCDayTicks  (86400ULL * kGBCartRTCTicksPerSecond)
+
+GBCartRTC *GBCartRTCCreate(void)
+{
+    GBCartRTC *rtc = malloc(sizeof(GBCartRTC));
+
+    if (rtc)
+    {
+        rtc->tick = NULL;
+        rtc->baseTick = 0;
+        rtc->baseTime = 0;
+
+        rtc->halted = false;
+        rtc->carry = false;
+
+        rtc->latch = 0xFF;
+        bzero(rtc->latched, sizeof(rtc->latched));
+    }
+
+    return rtc;
+}
+
+void GBCartRTCDestroy(GBCartRTC *this)
+{
+    free(this);
+}
+
+static uint64_t __GBCartRTCNow(GBCartRTC *this)
+{
+    if (this->halted || !this->tick)
+        return this->baseTime;
+
+    // The emulated clock can be behind the base for a moment (a snapshot restores it before the RTC). The RTC holds still instead of wrapping.
+    if (*this->tick < this->baseTick)
+        return this->baseTime;
+
+    return this->baseTime + (*this->tick - this->baseTick);
+}
+
+// Restart counting from `time` now
+static void __GBCartRTCRebase(GBCartRTC *this, uint64_t time)
+{
+    if (time >= 512 * kGBCartRTCDayTicks)
+    {
+        time %= 512 * kGBCartRTCDayTicks;
+        this->carry = true;
+    }
+
+    this->baseTime = time;
+    this->baseTick = this->tick ? *this->tick : 0;
+}
+
+void __GBCartRTCSetClock(GBCartRTC *this, uint64_t *tick)
+{
+    uint64_t time = __GBCartRTCNow(this);
+
+    this->tick = tick;
+    __GBCartRTCRebase(this, time);
+}
+
+void GBCartRTCLatch(GBCartRTC *this, uint8_t byte)
+{
+    if (this->latch == 0x00 && byte == 0x01)
+    {
+        __GBCartRTCRebase(this, __GBCartRTCNow(this));
+
+        uint64_t seconds = this->baseTime / kGBCartRTCTicksPerSecond;
+        uint16_t days = seconds / 86400;
+
+        this->latched[kGBCartRTCSeconds - kGBCartRTCSeconds] = seconds % 60;
+        this->latched[kGBCartRTCMinutes - kGBCartRTCSeconds] = (seconds / 60) % 60;
+        this->latched[kGBCartRTCHours - kGBCartRTCSeconds] = (seconds / 3600) % 24;
+        this->latched[kGBCartRTCDaysLow - kGBCartRTCSeconds] = days & 0xFF;
+        this->latched[kGBCartRTCDaysHigh - kGBCartRTCSeconds] = (days >> 8) | (this->halted ? kGBCartRTCHaltFlag : 0) | (this->carry ? kGBCartRTCCarryFlag : 0);
+    }
+
+    this->latch = byte;
+}
+
+uint8_t GBCartRTCRead(GBCartRTC *this, uint8_t reg)
+{
+    if (reg < kGBCartRTCSeconds || reg > kGBCartRTCDaysHigh)
+        return 0xFF;
+
+    return this->latched[reg - kGBCartRTCSeconds];
+}
+
+void GBCartRTCWrite(GBCartRTC *this, uint8_t reg, uint8_t byte)
+{
+    if (reg < kGBCartRTCSeconds || reg > kGBCartRTCDaysHigh)
+        return;
+
+    uint64_t time = __GBCartRTCNow(this);
+    uint64_t seconds = time / kGBCartRTCTicksPerSecond;
+    uint64_t fraction = time % kGBCartRTCTicksPerSecond;
+
+    uint64_t second = seconds % 60;
+    uint64_t minute = (seconds / 60) % 60;
+    uint64_t hour = (seconds / 3600) % 24;
+    uint64_t day = seconds / 86400;
+
+    switch (reg)
+    {
+        case kGBCartRTCSeconds:
+            // This also restarts the current second
+            second = byte & 0x3F;
+            fraction = 0;
+        break;
+        case kGBCartRTCMinutes:
+            minute = byte & 0x3F;
+        break;
+        case kGBCartRTCHours:
+            hour = byte & 0x1F;
+        break;
+        case kGBCartRTCDaysLow:
+            day = (day & 0x100) | byte;
+        break;
+        case kGBCartRTCDaysHigh:
+            day = (day & 0xFF) | ((byte & 0x01) << 8);
+        break;
+    }
+
+    time = ((((day * 24) + hour) * 60 + minute) * 60 + second) * kGBCartRTCTicksPerSecond + fraction;
+    __GBCartRTCRebase(this, time);
+
+    if (reg == kGBCartRTCDaysHigh)
+    {
+        this->halted = !!(byte & kGBCartRTCHaltFlag);
+        this->carry = !!(byte & kGBCartRTCCarryFlag);
+    }
+
+    this->latched[reg - kGBCartRTCSeconds] = byte;
+}
+
 #pragma mark - RAM Structure
 
 GBCartRAM *GBCartRAMCreateWithBanks(uint8_t banks)
+{
+    return GBCartRAMCreateWithSize(banks * (kGBMemoryBankSize * 2));
+}
+
+GBCartRAM *GBCartRAMCreateWithSize(uint32_t size)
 {
     GBCartRAM *ram = malloc(sizeof(GBCartRAM));
 
     if (ram)
     {
-        ram->ramData = malloc(banks * (kGBMemoryBankSize * 2));
+        ram->ramData = malloc(size);
 
-        if (!ram->ramData) {
+        // Clock only carts don't have any RAM
+        if (size && !ram->ramData) {
             free(ram);
             return NULL;
         } else {
             #ifdef __APPLE__
                 // This warns if we ignore the result implicitly
-                __unused int result = SecRandomCopyBytes(kSecRandomDefault, banks * (kGBMemoryBankSize * 2), ram->ramData);
+                __unused int result = SecRandomCopyBytes(kSecRandomDefault, size, ram->ramData);
             #else /* !defined(__APPLE__) */
-                bzero(ram->ramData, banks * (kGBMemoryBankSize * 2));
+                bzero(ram->ramData, size);
             #endif /* defined(__APPLE__) */
         }
 
@@ -143,8 +459,24 @@ GBCartRAM *GBCartRAMCreateWithBanks(uint8_t banks)
         ram->start = kGBCartRAMBankStart;
         ram->end = kGBCartRAMBankEnd;
 
-        ram->maxBank = banks;
+        // Carts have 512 bytes (MBC2), 2 KB or some number of whole banks
+        ram->maxBank = size ? (size + (kGBMemoryBankSize * 2) - 1) / (kGBMemoryBankSize * 2) : 1;
         ram->bank = 0;
+        ram->size = size;
+        ram->mmu = NULL;
+
+        ram->bankStart = ram->ramData;
+        ram->bankMask = size ? ((size < (kGBMemoryBankSize * 2)) ? size : (kGBMemoryBankSize * 2)) - 1 : 0;
+        ram->unusedBits = 0;
+
+        ram->rtc = NULL;
+        ram->rtcRegister = 0;
+
+        ram->mapped = false;
+        ram->dirty = false;
+        ram->dirtyPages = NULL;
+        ram->dirtyPageSize = 0;
+        ram->dirtyPageCount = 0;
 
         ram->enabled = true;
         ram->installed = false;
@@ -158,7 +490,10 @@ void GBCartRAMDestroy(GBCartRAM *this)
     if (this->installed)
         fprintf(stderr, "Warning: Cartridge RAM destroyed before cartridge successfully ejected!\n");
 
-    free(this->ramData);
+    if (this->rtc)
+        GBCartRTCDestroy(this->rtc);
+
+    __GBCartRAMReleaseData(this);
     free(this);
 }
 
@@ -167,9 +502,21 @@ void GBCartRAMWriteDirect(GBCartRAM *this, uint16_t address, uint8_t byte)
     if (!this->enabled)
         return;
 
-    uint8_t *bankStart = this->ramData + (this->bank * (kGBMemoryBankSize * 2));
+    if (this->rtcRegister)
+    {
+        GBCartRTCWrite(this->rtc, this->rtcRegister, byte);
+
+        return;
+    }
+
+    uint16_t offset = (address - kGBCartRAMBankStart) & this->bankMask;
+    this->bankStart[offset] = byte | this->unusedBits;
 
-    bankStart[address & (~0xA0)] = byte;
+    if (this->mapped)
+    {
+        this->dirtyPages[((this->bankStart - this->ramData) + offset) / this->dirtyPageSize] = true;
+        this->dirty = true;
+    }
 }
 
 uint8_t GBCartRAMReadDirect(GBCartRAM *this, uint16_t address)
@@ -177,9 +524,182 @@ uint8_t GBCartRAMReadDirect(GBCartRAM *this, uint16_t address)
     if (!this->enabled)
         return 0xFF;
 
-    uint8_t *bankStart = this->ramData + (this->bank * (kGBMemoryBankSize * 2));
+    if (this->rtcRegister)
+        return GBCartRTCRead(this->rtc, this->rtcRegister);
+
+    return this->bankStart[(address - kGBCartRAMBankStart) & this->bankMask];
+}
+
+void __GBCartRAMSelectBank(GBCartRAM *this, bool enabled, uint8_t bank)
+{
+    bank %= this->maxBank;
+
+    if (!this->size)
+        enabled = false;
+
+    if (enabled == this->enabled && bank == this->bank && !this->rtcRegister)
+        return;
+
+    this->enabled = enabled;
+    this->bank = bank;
+    this->rtcRegister = 0;
+    this->bankStart = this->ramData + (bank * (kGBMemoryBankSize * 2));
 
-    return bankStart[address & (~0xA0)];
+    __GBCartRAMMapPages(this);
+}
+
+void __GBCartRAMSelectClock(GBCartRAM *this, bool enabled, uint8_t reg)
+{
+    if (enabled == this->enabled && reg == this->rtcRegister)
+        return;
+
+    this->enabled = enabled;
+    this->rtcRegister = reg;
+
+    __GBCartRAMMapPages(this);
+}
+
+void __GBCartRAMMapPages(GBCartRAM *this)
+{
+    if (!this->mmu)
+        return;
+
+    // Clock registers are read through the handler
+    if (!this->enabled || this->rtcRegister)
+    {
+        GBMemoryManagerUnmapPages(this->mmu, kGBCartRAMBankStart, kGBCartRAMBankEnd);
+
+        return;
+    }
+
+    // Writes to a save file are left to the handler so it can mark them dirty
+    uint8_t *writeStart = (this->mapped || this->unusedBits) ? NULL : this->bankStart;
+
+    // Carts with less than a bank of RAM repeat it through the whole bank
+    for (uint32_t start = kGBCartRAMBankStart; start <= kGBCartRAMBankEnd; start += this->bankMask + 1)
+        GBMemoryManagerMapPages(this->mmu, start, start + this->bankMask, this->bankStart, writeStart);
+}
+
+void __GBCartRAMReleaseData(GBCartRAM *this)
+{
+    if (this->mapped) {
+        GBCartRAMFlush(this, true);
+        munmap(this->ramData, this->size);
+
+        free(this->dirtyPages);
+        this->dirtyPages = NULL;
+    } else {
+        free(this->ramData);
+    }
+
+    this->ramData = NULL;
+    this->mapped = false;
+}
+
+bool GBCartRAMAttachFile(GBCartRAM *this, const char *path)
+{
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error: Couldn't open save file '%s'!\n", path);
+
+        return false;
+    }
+
+    struct stat stats;
+
+    if (fstat(fd, &stats) || (stats.st_size != this->size && ftruncate(fd, this->size)))
+    {
+        fprintf(stderr, "Error: Couldn't size save file '%s' to %u bytes!\n", path, this->size);
+        close(fd);
+
+        return false;
+    }
+
+    uint8_t *mapping = mmap(NULL, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Error: Couldn't map save file '%s'!\n", path);
+
+        return false;
+    }
+
+    uint32_t pageSize = (uint32_t)sysconf(_SC_PAGESIZE);
+    uint32_t pageCount = (this->size + pageSize - 1) / pageSize;
+    bool *dirtyPages = calloc(pageCount, sizeof(bool));
+
+    if (!dirtyPages)
+    {
+        munmap(mapping, this->size);
+
+        return false;
+    }
+
+    // A new file starts out with whatever the RAM holds now
+    bool fresh = !stats.st_size;
+
+    if (fresh)
+        memcpy(mapping, this->ramData, this->size);
+
+    __GBCartRAMReleaseData(this);
+
+    this->ramData = mapping;
+    this->mapped = true;
+
+    this->dirtyPages = dirtyPages;
+    this->dirtyPageSize = pageSize;
+    this->dirtyPageCount = pageCount;
+    this->dirty = false;
+
+    if (fresh)
+    {
+        for (uint32_t i = 0; i < pageCount; i++)
+            dirtyPages[i] = true;
+
+        this->dirty = true;
+    }
+
+    this->bankStart = mapping + (this->bank * (kGBMemoryBankSize * 2));
+    __GBCartRAMMapPages(this);
+
+    return true;
+}
+
+void GBCartRAMFlush(GBCartRAM *this, bool wait)
+{
+    if (!this->mapped || !this->dirty)
+        return;
+
+    uint32_t page = 0;
+
+    // One msync for each run of dirty pages
+    while (page < this->dirtyPageCount)
+    {
+        if (!this->dirtyPages[page])
+        {
+            page++;
+
+            continue;
+        }
+
+        uint32_t first = page;
+
+        while (page < this->dirtyPageCount && this->dirtyPages[page])
+            this->dirtyPages[page++] = false;
+
+        uint32_t start = first * this->dirtyPageSize;
+        uint32_t end = page * this->dirtyPageSize;
+
+        if (end > this->size)
+            end = this->size;
+
+        msync(this->ramData + start, end - start, wait ? MS_SYNC : MS_ASYNC);
+    }
+
+    this->dirty = false;
 }
 
 bool GBCartRAMOnInstall(GBCartRAM *this, GBGameboy *gameboy)
@@ -189,7 +709,17 @@ bool GBCartRAMOnInstall(GBCartRAM *this, GBGameboy *gameboy)
 
     bool success = GBMemoryManagerInstallSpace(gameboy->cpu->mmu, (GBMemorySpace *)this);
 
-    if (success) this->installed = true;
+    if (success)
+    {
+        this->installed = true;
+        this->mmu = gameboy->cpu->mmu;
+
+        if (this->rtc)
+            __GBCartRTCSetClock(this->rtc, &gameboy->clock->internalTick);
+
+        __GBCartRAMMapPages(this);
+    }
+
     return success;
 }
 
@@ -200,7 +730,14 @@ bool GBCartRAMOnEject(GBCartRAM *this, GBGameboy *gameboy)
 
     bool success = GBCartMemGenericOnEject((GBMemorySpace *)this, gameboy);
 
-    if (success) this->install = false;
+    if (success) this->installed = false;
+    this->mmu = NULL;
+
+    if (this->rtc)
+        __GBCartRTCSetClock(this->rtc, NULL);
+
+    GBCartRAMFlush(this, true);
+
     return success;
 }
 
@@ -328,14 +865,14 @@ GBCartInfo *GBCartInfoCreateWithHeader(GBCartHeader *header, bool validate)
             break;
         }
 
-        if (header->romSize <= 0x07) {
-            info->romSize = (32 * 0x1000) << header->romSize; // 32 KB << header->romSize
+        if (header->romSize <= 0x08) {
+            info->romSize = (32 * 0x400) << header->romSize; // 32 KB << header->romSize
         } else {
             switch (header->romSize)
             {
-                case 0x52: info->romSize = 72 * (2 * kGBMemoryBankSize); break; // 72 banks
-                case 0x53: info->romSize = 80 * (2 * kGBMemoryBankSize); break; // 80 banks
-                case 0x54: info->romSize = 96 * (2 * kGBMemoryBankSize); break; // 96 banks
+                case 0x52: info->romSize = 72 * (4 * kGBMemoryBankSize); break; // 72 banks
+                case 0x53: info->romSize = 80 * (4 * kGBMemoryBankSize); break; // 80 banks
+                case 0x54: info->romSize = 96 * (4 * kGBMemoryBankSize); break; // 96 banks
                 default:
                     fprintf(stderr, "Warning: Unknown ROM size '0x%02X' in cart '%s'.\n", header->romSize, info->title);
                     info->romSize = -1; // This means we were unable to determine ROM size.
@@ -345,19 +882,19 @@ GBCartInfo *GBCartInfoCreateWithHeader(GBCartHeader *header, bool validate)
         }
 
         if (info->mbcType == kGBCartMBCType2) {
-            info->ramSize = 4 * 512;
+            info->ramSize = 512; // 512 half bytes, kept one per byte
         } else {
             switch (header->ramSize)
             {
                 case 0: info->ramSize = 0; break;
                 case 1:
-                    info->ramSize = 2 * 0x1000; // 2 KB
+                    info->ramSize = 2 * 0x400; // 2 KB
                 break;
                 case 2:
-                    info->ramSize = 8 * 0x1000; // 8 KB
+                    info->ramSize = 8 * 0x400; // 8 KB
                 break;
                 case 3:
-                    info->ramSize = 4 * 8 * 0x1000; // 32 KB
+                    info->ramSize = 4 * 8 * 0x400; // 32 KB
                 break;
                 default:
                     fprintf(stderr, "Warning: Unknown RAM size '0x%02X' in cart '%s'.\n", header->ramSize, info->title);
@@ -381,7 +918,7 @@ void GBCartInfoDestroy(GBCartInfo *this)
 
 #pragma mark - Cartridge Structure
 
-GBCartridge *GBCartridgeCreate(uint8_t *romData, uint32_t romSize)
+static GBCartridge *__GBCartridgeCreate(uint8_t *romData, uint32_t romSize, bool shared)
 {
     GBCartridge *cartridge = malloc(sizeof(GBCartridge));
 
@@ -403,7 +940,7 @@ GBCartridge *GBCartridgeCreate(uint8_t *romData, uint32_t romSize)
         {
             // There was an invalid value in the header.
             // We just take the largest multiple of the block size passed into this function.
-            cartridge->info->romSize = romSize & 0x3FFF;
+            cartridge->info->romSize = romSize & ~0x3FFF;
         }
 
         if (cartridge->info->romSize < romSize)
@@ -416,11 +953,33 @@ GBCartridge *GBCartridgeCreate(uint8_t *romData, uint32_t romSize)
             return NULL;
         }
 
-        uint8_t romBanks = cartridge->info->romSize / (4 * kGBMemoryBankSize);
-        uint8_t ramBanks = cartridge->info->ramSize / (2 * kGBMemoryBankSize);
+        // Every bank the header claims has to be there, whether the data is used where it is or copied
+        if (cartridge->info->romSize > romSize)
+        {
+            fprintf(stderr, "Error: Cartridge ROM data is smaller than its header says!\n");
+
+            GBCartInfoDestroy(cartridge->info);
+            free(cartridge);
+
+            return NULL;
+        }
+
+        uint16_t romBanks = cartridge->info->romSize / (4 * kGBMemoryBankSize);
+
+        // The clock is reached through the RAM (even when there isn't any)
+        if (cartridge->info->ramSize || cartridge->info->hasTimer) {
+            cartridge->ram = GBCartRAMCreateWithSize(cartridge->info->ramSize);
+
+            if (cartridge->ram && cartridge->info->hasTimer)
+            {
+                cartridge->ram->rtc = GBCartRTCCreate();
 
-        if (cartridge->info->ramSize) {
-            cartridge->ram = GBCartRAMCreateWithBanks(ramBanks);
+                if (!cartridge->ram->rtc)
+                {
+                    GBCartRAMDestroy(cartridge->ram);
+                    cartridge->ram = NULL;
+                }
+            }
 
             if (!cartridge->ram)
             {
@@ -433,42 +992,137 @@ GBCartridge *GBCartridgeCreate(uint8_t *romData, uint32_t romSize)
             cartridge->ram = NULL;
         }
 
+        void (*writeFunc)(GBCartROM *this, uint16_t address, uint8_t byte) = NULL;
+
         switch (cartridge->info->mbcType)
         {
             case kGBCartMBCTypeNone:
-                cartridge->rom = GBCartROMCreateWithNullMapper(romData, romBanks);
+                writeFunc = GBCartROMWriteNull;
             break;
             case kGBCartMBCType1:
-                cartridge->rom = GBCartROMCreateWithMBC1(romData, romBanks);
+                writeFunc = GBCartROMWriteMBC1;
+            break;
+            case kGBCartMBCType2:
+                writeFunc = GBCartROMWriteMBC2;
 
-                cartridge->ram->enabled = false;
+                if (cartridge->ram)
+                    cartridge->ram->unusedBits = 0xF0;
             break;
-            default: cartridge->rom = NULL; break;
+            case kGBCartMBCType3:
+                writeFunc = GBCartROMWriteMBC3;
+            break;
+            case kGBCartMBCType5:
+                writeFunc = GBCartROMWriteMBC5;
+            break;
+            default: break;
+        }
+
+        // RAM behind a mapper stays off until the game enables it
+        if (cartridge->ram && cartridge->info->mbcType != kGBCartMBCTypeNone)
+            cartridge->ram->enabled = false;
+
+        if (!writeFunc) {
+            cartridge->rom = NULL;
+        } else if (shared) {
+            cartridge->rom = GBCartROMCreateGenericShared(romData, romBanks, GBCartROMReadBanked, writeFunc);
+        } else {
+            cartridge->rom = GBCartROMCreateGeneric(romData, romBanks, GBCartROMReadBanked, writeFunc);
         }
 
         if (!cartridge->rom)
         {
-            GBCartInfoDestroy(cartridge->info);
-
-            if (cartridge->info->ramSize)
+            if (cartridge->ram)
                 GBCartRAMDestroy(cartridge->ram);
 
+            GBCartInfoDestroy(cartridge->info);
             free(cartridge);
 
             return NULL;
         }
 
+        cartridge->rom->ram = cartridge->ram;
+
+        cartridge->mapping = NULL;
+        cartridge->mappingSize = 0;
+
         cartridge->installed = false;
     }
 
     return cartridge;
 }
 
+GBCartridge *GBCartridgeCreate(uint8_t *romData, uint32_t romSize)
+{
+    if (romSize < kGBCartHeaderStart + sizeof(GBCartHeader))
+    {
+        fprintf(stderr, "Error: Cartridge ROM data is too small to have a header!\n");
+
+        return NULL;
+    }
+
+    return __GBCartridgeCreate(romData, romSize, false);
+}
+
+GBCartridge *GBCartridgeCreateWithFile(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error: Couldn't open cartridge file '%s'!\n", path);
+
+        return NULL;
+    }
+
+    struct stat stats;
+
+    if (fstat(fd, &stats) || stats.st_size < (off_t)(kGBCartHeaderStart + sizeof(GBCartHeader)) || stats.st_size > UINT32_MAX)
+    {
+        fprintf(stderr, "Error: Cartridge file '%s' isn't a usable size!\n", path);
+        close(fd);
+
+        return NULL;
+    }
+
+    // Read only and private, so every gameboy running this file shares the same page cache pages
+    void *mapping = mmap(NULL, stats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Error: Couldn't map cartridge file '%s'!\n", path);
+
+        return NULL;
+    }
+
+    GBCartridge *cartridge = __GBCartridgeCreate(mapping, (uint32_t)stats.st_size, true);
+
+    if (!cartridge)
+    {
+        munmap(mapping, stats.st_size);
+
+        return NULL;
+    }
+
+    cartridge->mapping = mapping;
+    cartridge->mappingSize = stats.st_size;
+
+    return cartridge;
+}
+
 GBCartHeader *GBCartridgeGetHeader(GBCartridge *cart)
 {
     return (GBCartHeader *)(cart->rom->romData + kGBCartHeaderStart);
 }
 
+bool GBCartridgeAttachSave(GBCartridge *this, const char *path)
+{
+    if (!this->info->ramSize || !this->info->hasBattery)
+        return false;
+
+    return GBCartRAMAttachFile(this->ram, path);
+}
+
 bool GBCartridgeChecksumIsValid(GBCartridge *this)
 {
     uint16_t *checksum = &((GBCartHeader *)(this->rom->romData + kGBCartHeaderStart))->checksum;
@@ -497,7 +1151,10 @@ void GBCartridgeDestroy(GBCartridge *this)
 
     GBCartROMDestroy(this->rom);
 
-    if (this->info->ramSize)
+    if (this->mapping)
+        munmap(this->mapping, this->mappingSize);
+
+    if (this->ram)
         GBCartRAMDestroy(this->ram);
 
     GBCartInfoDestroy(this->info);
@@ -511,7 +1168,7 @@ bool GBCartridgeUnmap(GBCartridge *this, GBGameboy *gameboy)
     if (!success)
         return false;
 
-    if (this->info->ramSize)
+    if (this->ram)
         success = this->ram->eject(this->ram, gameboy);
 
     return success;
@@ -524,12 +1181,123 @@ bool GBCartridgeMap(GBCartridge *this, GBGameboy *gameboy)
     if (!success)
         return false;
 
-    if (this->info->ramSize)
+    if (this->ram)
         success = this->ram->install(this->ram, gameboy);
 
     return success;
 }
 
+#pragma mark - Cartridge State
+
+// What a snapshot keeps of the cart. The RAM contents follow it.
+typedef struct {
+    uint16_t lowBank;
+    uint16_t bank;
+    uint16_t bankSelect;
+    uint8_t bankHigh;
+    bool bankMode;
+    bool ramEnabled;
+
+    bool ramOn;
+    uint8_t ramBank;
+    uint8_t rtcRegister;
+
+    GBCartRTC rtc;
+} __GBCartridgeState;
+
+size_t GBCartridgeStateSize(GBCartridge *this)
+{
+    return sizeof(__GBCartridgeState) + (this->ram ? this->ram->size : 0);
+}
+
+void GBCartridgeSaveState(GBCartridge *this, void *buffer)
+{
+    __GBCartridgeState state;
+    bzero(&state, sizeof(state));
+
+    state.lowBank = this->rom->lowBank;
+    state.bank = this->rom->bank;
+    state.bankSelect = this->rom->bankSelect;
+    state.bankHigh = this->rom->bankHigh;
+    state.bankMode = this->rom->bankMode;
+    state.ramEnabled = this->rom->ramEnabled;
+
+    if (this->ram)
+    {
+        state.ramOn = this->ram->enabled;
+        state.ramBank = this->ram->bank;
+        state.rtcRegister = this->ram->rtcRegister;
+
+        if (this->ram->rtc)
+            state.rtc = *this->ram->rtc;
+
+        memcpy((uint8_t *)buffer + sizeof(state), this->ram->ramData, this->ram->size);
+    }
+
+    memcpy(buffer, &state, sizeof(state));
+}
+
+// Only pages which actually changed go back to a save file
+static void __GBCartRAMRestoreData(GBCartRAM *this, const uint8_t *data)
+{
+    if (!this->mapped)
+    {
+        memcpy(this->ramData, data, this->size);
+
+        return;
+    }
+
+    for (uint32_t page = 0; page < this->dirtyPageCount; page++)
+    {
+        uint32_t start = page * this->dirtyPageSize;
+        uint32_t length = (this->size - start < this->dirtyPageSize) ? this->size - start : this->dirtyPageSize;
+
+        if (!memcmp(this->ramData + start, data + start, length))
+            continue;
+
+        memcpy(this->ramData + start, data + start, length);
+
+        this->dirtyPages[page] = true;
+        this->dirty = true;
+    }
+}
+
+void GBCartridgeRestoreState(GBCartridge *this, const void *buffer)
+{
+    __GBCartridgeState state;
+    memcpy(&state, buffer, sizeof(state));
+
+    this->rom->bankSelect = state.bankSelect;
+    this->rom->bankHigh = state.bankHigh;
+    this->rom->bankMode = state.bankMode;
+    this->rom->ramEnabled = state.ramEnabled;
+
+    // The page table may not match the banks even when they didn't change
+    __GBCartROMSelectBanks(this->rom, state.lowBank, state.bank);
+    __GBCartROMMapPages(this->rom);
+
+    if (!this->ram)
+        return;
+
+    __GBCartRAMRestoreData(this->ram, (const uint8_t *)buffer + sizeof(state));
+
+    this->ram->enabled = state.ramOn;
+    this->ram->bank = state.ramBank;
+    this->ram->rtcRegister = state.rtcRegister;
+    this->ram->bankStart = this->ram->ramData + (state.ramBank * (kGBMemoryBankSize * 2));
+
+    __GBCartRAMMapPages(this->ram);
+
+    // The snapshot's time is counted from the snapshot's tick, which the gameboy's clock is back at
+    if (this->ram->rtc)
+    {
+        uint64_t *tick = this->ram->rtc->tick;
+
+        *this->ram->rtc = state.rtc;
+        this->ram->rtc->tick = tick;
+    }
+}
+
 bool GBCartMemGenericOnEject(GBMemorySpace *this, GBGameboy *gameboy)
 {
     for (uint8_t i = 0; i < 0x10; i++)
@@ -541,5 +1309,7 @@ bool GBCartMemGenericOnEject(GBMemorySpace *this, GBGameboy *gameboy)
             gameboy->cpu->mmu->highSpaces[i] = gGBMemorySpaceNull;
     }
 
+    GBMemoryManagerUnmapPages(gameboy->cpu->mmu, this->start, this->end);
+
     return true;
 }
@@ -8,7 +8,7 @@
 
 GBTimerPort *GBTimerPortCreate(uint16_t address)
 {
-    GBTimerPort *port = malloc(sizeof(GBTimerPort));
+    GBTimerPort *port = GBAllocate(sizeof(GBTimerPort));
 
     if (port)
     {
@@ -18,6 +18,7 @@ GBTimerPort *GBTimerPortCreate(uint16_t address)
         port->read = (void *)__GBIORegisterSimpleRead;
 
         port->value = 0;
+        port->clock = NULL;
     }
 
     return port;
@@ -25,7 +26,35 @@ GBTimerPort *GBTimerPortCreate(uint16_t address)
 
 void __GBDividerPortWrite(GBTimerPort *port, uint8_t byte)
 {
+    // Writing any value resets the whole internal counter (not just the top byte)
+    port->clock->tick = 0;
     port->value = 0;
+
+    port->clock->events[kGBClockEventTimer] = __GBClockTimerNextEvent(port->clock, port->clock->internalTick);
+}
+
+uint8_t __GBDividerPortRead(GBTimerPort *port)
+{
+    // The divider is the top byte of the internal counter. It is only calculated when read.
+    port->value = port->clock->tick >> 8;
+
+    return port->value;
+}
+
+void __GBTimerPortWrite(GBTimerPort *port, uint8_t byte)
+{
+    // Writing TIMA while it is waiting to be reloaded cancels the reload (and the interrupt)
+    port->clock->timerOverflow = false;
+    port->value = byte;
+
+    port->clock->events[kGBClockEventTimer] = __GBClockTimerNextEvent(port->clock, port->clock->internalTick);
+}
+
+void __GBTimerControlPortWrite(GBTimerPort *port, uint8_t byte)
+{
+    port->value = byte;
+
+    port->clock->events[kGBClockEventTimer] = __GBClockTimerNextEvent(port->clock, port->clock->internalTick);
 }
 
 uint8_t __GBTimerControlPortRead(GBTimerPort *port)
@@ -39,7 +68,7 @@ uint8_t gGBTimerBitLookup[4] = {9, 3, 5, 7};
 
 GBClock *GBClockCreate(void)
 {
-    GBClock *clock = malloc(sizeof(GBClock));
+    GBClock *clock = GBAllocate(sizeof(GBClock));
 
     if (clock)
     {
@@ -47,15 +76,29 @@ GBClock *GBClockCreate(void)
 
         clock->divider = GBTimerPortCreate(kGBDividerAddress);
         clock->timer = GBTimerPortCreate(kGBTimerAddress);
-        clock->timerModulus = GBTimerPortCreate(kGBTimerModuloAddress);
         clock->timerControl = GBTimerPortCreate(kGBTimerControlAddress);
 
         clock->timerControl->read = __GBTimerControlPortRead;
+        clock->timerControl->write = __GBTimerControlPortWrite;
+        clock->divider->read = __GBDividerPortRead;
         clock->divider->write = __GBDividerPortWrite;
+        clock->timer->write = __GBTimerPortWrite;
+
+        clock->divider->clock = clock;
+        clock->timer->clock = clock;
+        clock->timerControl->clock = clock;
+
+        clock->timerOverflow = false;
+        clock->overflowTick = 0;
 
         clock->internalTick = 0;
         clock->tick = 0;
 
+        for (uint8_t i = 0; i < kGBClockEventCount; i++)
+            clock->events[i] = kGBClockNever;
+
+        clock->frameLimit = kGBClockNever;
+
         clock->install = __GBClockInstall;
     }
 
@@ -148,12 +191,65 @@ void __GBClockTimerDebug(GBClock *this, GBProcessor *cpu, GBGraphicsDriver *driv
 // 0xC399
 // 0xC3B1
 
-void GBClockTick(GBClock *this)
+#pragma mark - Timer
+
+uint64_t __GBClockTimerNextEvent(GBClock *this, uint64_t tick)
 {
-    if (!this->gameboy || this->gameboy->cpu->state.mode == kGBProcessorModeOff)
-        return;
+    uint64_t next = kGBClockNever;
+
+    if (this->timerControl->value & kGBTimerEnableFlag)
+    {
+        // TIMA counts up every time the selected bit of the internal counter falls.
+        uint16_t period = 1 << (gGBTimerBitLookup[this->timerControl->value & 0x3] + 1);
+
+        next = tick + (period - (this->tick & (period - 1)));
+    }
+
+    if (this->timerOverflow && this->overflowTick < next)
+        next = this->overflowTick;
+
+    return next;
+}
+
+void __GBClockTimerTick(GBClock *this, uint64_t tick)
+{
+    if (this->timerOverflow && this->overflowTick == tick)
+    {
+        this->gameboy->cpu->ic->interruptFlagPort->value |= (1 << kGBInterruptTimer);
+        this->timer->value = *this->timerModulus;
+
+        this->timerOverflow = false;
+    }
+
+    if (this->timerControl->value & kGBTimerEnableFlag)
+    {
+        uint16_t period = 1 << (gGBTimerBitLookup[this->timerControl->value & 0x3] + 1);
+
+        if (!(this->tick & (period - 1)))
+        {
+            this->timer->value++;
+
+            if (!this->timer->value)
+            {
+                this->overflowTick = tick + kGBTimerOverflowDelay;
+                this->timerOverflow = true;
+            }
+        }
+    }
+
+    this->events[kGBClockEventTimer] = __GBClockTimerNextEvent(this, tick);
+}
+
+#pragma mark - Scheduler
 
-    bool timerEnable = !!(this->timerControl->value & kGBTimerEnableFlag);
+void GBClockSchedule(GBClock *this, uint8_t event, uint64_t tick)
+{
+    if (tick < this->events[event])
+        this->events[event] = tick;
+}
+
+static void __GBClockDispatch(GBClock *this, uint64_t tick)
+{
     GBMemoryManager *mmu = this->gameboy->cpu->mmu;
     GBGraphicsDriver *driver = this->gameboy->driver;
     GBDMARegister *dma = this->gameboy->dma;
@@ -162,55 +258,123 @@ void GBClockTick(GBClock *this)
 
     //__GBClockTimerDebug(this, cpu, driver);
 
-    this->internalTick++;
-    this->tick++;
+    if (this->events[kGBClockEventTimer] <= tick)
+        __GBClockTimerTick(this, tick);
 
-    if (this->timerOverflow)
+    if (this->events[kGBClockEventMemory] <= tick)
     {
-        this->overflowTicks++;
+        // A write may have touched a register the driver or DMA care about. Let them look again this tick.
+        if (mmu->mar && mmu->isWrite)
+        {
+            this->events[kGBClockEventDriver] = tick;
+            this->events[kGBClockEventDMA] = tick;
+        }
 
-        if (this->overflowTicks == 4) {
-            this->gameboy->cpu->ic->interruptFlagPort->value |= (1 << kGBInterruptTimer);
-        } else if (this->overflowTicks == 5) {
-            this->timer->value = this->timerModulus->value;
-        } else if (this->overflowTicks == 6) {
-            this->timer->value = this->timerModulus->value;
+        mmu->tick(mmu, tick);
 
-            this->timerOverflow = false;
-            this->overflowTicks = 0;
-        }
+        this->events[kGBClockEventMemory] = mmu->nextEvent(mmu, tick);
+    }
+
+    if (this->events[kGBClockEventDriver] <= tick)
+    {
+        driver->tick(driver, tick);
+
+        this->events[kGBClockEventDriver] = driver->nextEvent(driver, tick);
     }
 
-    if (timerEnable)
+    // A halted processor isn't run again until the timer or the driver raises an interrupt it's waiting on.
+    // The time in between is skipped in one go like any other stretch without events.
+    if (cpu->state.mode == kGBProcessorModeHalted && this->events[kGBClockEventProcessor] == kGBClockNever && GBInterruptControllerCheck(ic))
+        this->events[kGBClockEventProcessor] = tick;
+
+    if (this->events[kGBClockEventProcessor] <= tick)
     {
-        uint16_t flag = (1 << gGBTimerBitLookup[this->timerControl->value & 0x3]);
+        // Translated code may run several instructions at once, but never past anything else's next event.
+        uint64_t horizon = kGBClockNever;
 
-        if (this->divider->value & flag)
+        for (uint8_t i = 0; i < kGBClockEventCount; i++)
         {
-            this->timer->value++;
+            if (i != kGBClockEventProcessor && this->events[i] < horizon)
+                horizon = this->events[i];
+        }
 
-            if (!this->timer)
-            {
-                this->timerOverflow = true;
-                this->overflowTicks = 0;
-            }
+        if (horizon <= tick) {
+            cpu->budget = 0;
+        } else if (horizon - tick > UINT32_MAX) {
+            cpu->budget = UINT32_MAX;
+        } else {
+            cpu->budget = (uint32_t)(horizon - tick);
+        }
+
+        cpu->tick(cpu, tick);
+        ic->tick(ic, tick);
+
+        this->events[kGBClockEventProcessor] = cpu->nextEvent(cpu, tick);
+        this->events[kGBClockEventMemory] = mmu->nextEvent(mmu, tick);
+
+        // The fast core writes memory directly. The driver has already run this tick, so it looks again on the next one.
+        if (mmu->busWritten)
+        {
+            GBClockSchedule(this, kGBClockEventDriver, tick + 1);
+
+            mmu->busWritten = false;
         }
+
+        // DMA pauses while the processor is halted, so it needs to see every mode change.
+        if (dma->inProgress)
+            this->events[kGBClockEventDMA] = tick;
+    }
+
+    if (this->events[kGBClockEventDMA] <= tick)
+    {
+        dma->tick(dma, tick);
+
+        this->events[kGBClockEventDMA] = dma->nextEvent(dma, tick);
     }
+}
+
+uint64_t GBClockAdvance(GBClock *this, uint64_t ticks)
+{
+    uint64_t start = this->internalTick;
+    uint64_t end = start + ticks;
+
+    while (this->internalTick < end)
+    {
+        if (!this->gameboy || this->gameboy->cpu->state.mode == kGBProcessorModeOff)
+            break;
 
-    this->divider->value = this->tick >> 8;
+        uint64_t next = end;
 
-    // Get timer speed and set new value.
+        for (uint8_t i = 0; i < kGBClockEventCount; i++)
+        {
+            if (this->events[i] < next)
+                next = this->events[i];
+        }
+
+        // Anything scheduled in the past (from outside of the clock) runs on the next tick.
+        if (next <= this->internalTick)
+            next = this->internalTick + 1;
 
-    mmu->tick(mmu, this->internalTick);
-    driver->tick(driver, this->internalTick);
-    cpu->tick(cpu, this->internalTick);
-    ic->tick(ic, this->internalTick);
-    dma->tick(dma, this->internalTick);
+        this->tick += (uint16_t)(next - this->internalTick);
+        this->internalTick = next;
+
+        __GBClockDispatch(this, next);
+
+        if (this->gameboy->driver->frameCount >= this->frameLimit)
+            break;
+    }
+
+    return this->internalTick - start;
+}
+
+void GBClockTick(GBClock *this)
+{
+    GBClockAdvance(this, 1);
 }
 
 void GBClockDestroy(GBClock *this)
 {
-    free(this);
+    GBRelease(this);
 }
 
 bool __GBClockInstall(GBClock *this, struct __GBGameboy *gameboy)
@@ -219,7 +383,7 @@ bool __GBClockInstall(GBClock *this, struct __GBGameboy *gameboy)
 
     GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->divider);
     GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->timer);
-    GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->timerModulus);
+    this->timerModulus = GBIOMapperInstallRegister(gameboy->mmio, kGBTimerModuloAddress, 0x00);
     GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->timerControl);
 
     return true;
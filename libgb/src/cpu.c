@@ -11,9 +11,9 @@
 
 #include "指令集.h"
 
-GBProcessor *GBProcessorCreate(void)
+GBProcessor *GBProcessorCreate(uint8_t core)
 {
-    GBProcessor *cpu = malloc(sizeof(GBProcessor));
+    GBProcessor *cpu = GBAllocate(sizeof(GBProcessor));
 
     if (cpu)
     {
@@ -21,7 +21,7 @@ GBProcessor *GBProcessorCreate(void)
 
         if (!cpu->ic)
         {
-            free(cpu);
+            GBRelease(cpu);
 
             return NULL;
         }
@@ -31,7 +31,7 @@ GBProcessor *GBProcessorCreate(void)
         if (!cpu->mmu)
         {
             GBInterruptControllerDestroy(cpu->ic);
-            free(cpu);
+            GBRelease(cpu);
 
             return NULL;
         }
@@ -42,6 +42,8 @@ GBProcessor *GBProcessorCreate(void)
         cpu->state.enableIME = false;
         cpu->state.ime = false;
         cpu->state.a = 0;
+        cpu->state.f.reg = 0;
+        cpu->state.lazy.op = kGBLazyFlagsNone;
 
         cpu->state.bc = 0;
         cpu->state.de = 0;
@@ -59,11 +61,48 @@ GBProcessor *GBProcessorCreate(void)
         cpu->state.op = 0;
 
         cpu->state.bug = false;
+        cpu->state.cycles = 0;
+
+        cpu->core = core;
+        cpu->jit = NULL;
+        cpu->cache = NULL;
+        cpu->budget = 0;
+
+        bzero(&cpu->idle, sizeof(cpu->idle));
+        cpu->idle.enabled = (core != kGBProcessorCoreMicro);
 
         memcpy(cpu->decode_prefix, gGBInstructionSetCB, 0x100 * sizeof(GBProcessorOP *));
         memcpy(cpu->decode, gGBInstructionSet, 0x100 * sizeof(GBProcessorOP *));
 
-        cpu->tick = __GBProcessorTick;
+        if (core != kGBProcessorCoreMicro)
+        {
+            cpu->cache = GBProcessorDecodeCacheCreate();
+
+            if (!cpu->cache)
+            {
+                GBMemoryManagerDestroy(cpu->mmu);
+                GBInterruptControllerDestroy(cpu->ic);
+                GBRelease(cpu);
+
+                return NULL;
+            }
+
+            cpu->mmu->codeMap = cpu->cache->codeMap;
+
+            // Nothing here needs accesses to line up with memory ticks
+            cpu->mmu->synchronous = true;
+        }
+
+        if (core == kGBProcessorCoreFast) {
+            cpu->tick = __GBProcessorFastTick;
+            cpu->nextEvent = __GBProcessorFastNextEvent;
+        } else if (core == kGBProcessorCoreThreaded) {
+            cpu->tick = __GBProcessorThreadedTick;
+            cpu->nextEvent = __GBProcessorFastNextEvent;
+        } else {
+            cpu->tick = __GBProcessorTick;
+            cpu->nextEvent = __GBProcessorNextEvent;
+        }
     }
 
     return cpu;
@@ -71,9 +110,20 @@ GBProcessor *GBProcessorCreate(void)
 
 void GBProcessorDestroy(GBProcessor *this)
 {
+    if (this->jit)
+        GBProcessorJITDestroy(this->jit);
+
+    if (this->cache)
+        GBProcessorDecodeCacheDestroy(this->cache);
+
     GBMemoryManagerDestroy(this->mmu);
 
-    free(this);
+    GBRelease(this);
+}
+
+uint8_t GBProcessorReadFlags(GBProcessor *this)
+{
+    return __ALUFlags(this).reg;
 }
 
 void GBDispatchOP(GBProcessor *this)
@@ -227,3 +277,388 @@ void __GBProcessorTick(GBProcessor *this, uint64_t tick)
         } break;
     }
 }
+
+uint64_t __GBProcessorNextEvent(GBProcessor *this, uint64_t tick)
+{
+    switch (this->state.mode)
+    {
+        case kGBProcessorModeHalted: {
+            // Nothing changes until another component raises an interrupt. The clock wakes us up when one does.
+            if (!GBInterruptControllerCheck(this->ic))
+                return kGBClockNever;
+        } break;
+        case kGBProcessorModeStopped:
+        case kGBProcessorModeOff:
+            return kGBClockNever;
+        case kGBProcessorModePrefix:
+        case kGBProcessorModeStalled:
+        case kGBProcessorModeRun:
+        case kGBProcessorModeWait1:
+        case kGBProcessorModeWait2:
+        case kGBProcessorModeWait3:
+        case kGBProcessorModeWait4: {
+            // These modes just wait for memory access. There is nothing to do until the memory manager services us.
+            if (!this->state.accessed && this->mmu->accessed == &this->state.accessed && this->mmu->mar)
+                return this->mmu->nextEvent(this->mmu, tick);
+        } break;
+    }
+
+    // Fetching and interrupt dispatch run every tick.
+    return tick + 1;
+}
+
+#pragma mark - Idle Loops
+
+// Memory which only changes on clock events (or never)
+static bool __GBProcessorIdleReadable(uint16_t address)
+{
+    if (address <= kGBCartROMBankHighEnd)
+        return true;
+
+    if (address >= kGBWorkRAMStart && address <= kGBWorkRAMEnd)
+        return true;
+
+    // High RAM and the interrupt control register
+    if (address >= kGBHighRAMStart)
+        return true;
+
+    // The divider is worked out from the clock when it's read, so it changes on every tick.
+    switch (address)
+    {
+        case kGBTimerAddress:
+        case kGBTimerModuloAddress:
+        case kGBTimerControlAddress:
+        case kGBInterruptFlagAddress:
+            return true;
+    }
+
+    return (address >= kGBLCDControlPortAddress && address <= kGBLineWindowPortYAddress);
+}
+
+// Ops a polling loop may use. They only touch registers or read memory.
+static bool __GBProcessorIdleAllows(uint8_t op, uint8_t lo, uint8_t hi, uint8_t *reads)
+{
+    if (op >= 0x40 && op < 0xC0)
+    {
+        // halt, and ld (hl), r
+        if (op == 0x76 || (op & 0xF8) == 0x70)
+            return false;
+
+        if ((op & 0x07) == 0x06)
+            (*reads) |= kGBIdleLoopReadHL;
+
+        return true;
+    }
+
+    switch (op)
+    {
+        case 0x00: case 0x07: case 0x0F: case 0x17: case 0x1F: case 0x27: case 0x2F: case 0x37: case 0x3F:
+        case 0x04: case 0x05: case 0x0C: case 0x0D: case 0x14: case 0x15: case 0x1C: case 0x1D:
+        case 0x24: case 0x25: case 0x2C: case 0x2D: case 0x3C: case 0x3D:
+        case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E:
+        case 0x03: case 0x13: case 0x23: case 0x33: case 0x0B: case 0x1B: case 0x2B: case 0x3B:
+        case 0x09: case 0x19: case 0x29: case 0x39:
+        case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:
+            return true;
+
+        case 0x0A: (*reads) |= kGBIdleLoopReadBC; return true;
+        case 0x1A: (*reads) |= kGBIdleLoopReadDE; return true;
+        case 0xF2: (*reads) |= kGBIdleLoopReadC;  return true;
+
+        case 0xF0: return __GBProcessorIdleReadable(0xFF00 | lo);
+        case 0xFA: return __GBProcessorIdleReadable(lo | (hi << 8));
+
+        case 0xCB: {
+            // bit n, r and bit n, (hl) only read. Everything else is fine on registers.
+            if ((lo & 0x07) != 0x06)
+                return true;
+
+            if ((lo & 0xC0) != 0x40)
+                return false;
+
+            (*reads) |= kGBIdleLoopReadHL;
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+// Check every op from head to end (the branch back to head)
+static bool __GBProcessorIdleAnalyze(GBProcessor *this, uint16_t head, uint16_t end, uint8_t *reads)
+{
+    uint16_t pc = head;
+
+    (*reads) = 0;
+
+    while (pc < end)
+    {
+        uint8_t op = __GBMemoryManagerRead(this->mmu, pc);
+        uint8_t lo = __GBMemoryManagerRead(this->mmu, pc + 1);
+        uint8_t hi = __GBMemoryManagerRead(this->mmu, pc + 2);
+
+        if (!__GBProcessorIdleAllows(op, lo, hi, reads))
+            return false;
+
+        pc += (op == 0xCB) ? 2 : gGBInstructionLengths[op];
+    }
+
+    if (pc != end)
+        return false;
+
+    uint8_t op = __GBMemoryManagerRead(this->mmu, end);
+
+    return __GBProcessorIdleAllows(op, 0, 0, reads);
+}
+
+static bool __GBProcessorIdleReadsAreStable(GBProcessor *this)
+{
+    uint8_t reads = this->idle.reads;
+
+    if ((reads & kGBIdleLoopReadHL) && !__GBProcessorIdleReadable(this->state.hl))
+        return false;
+
+    if ((reads & kGBIdleLoopReadBC) && !__GBProcessorIdleReadable(this->state.bc))
+        return false;
+
+    if ((reads & kGBIdleLoopReadDE) && !__GBProcessorIdleReadable(this->state.de))
+        return false;
+
+    if ((reads & kGBIdleLoopReadC) && !__GBProcessorIdleReadable(0xFF00 | this->state.c))
+        return false;
+
+    return true;
+}
+
+static void __GBProcessorIdleArm(GBProcessor *this)
+{
+    this->idle.a = this->state.a;
+    this->idle.f = GBProcessorReadFlags(this);
+    this->idle.bc = this->state.bc;
+    this->idle.de = this->state.de;
+    this->idle.hl = this->state.hl;
+    this->idle.sp = this->state.sp;
+
+    this->idle.cycles = 0;
+    this->idle.budget = this->budget;
+    this->idle.armed = true;
+}
+
+// Called before every fetch on the fast cores. Returns true if time was skipped instead of running the next op.
+static bool __GBProcessorIdleSkip(GBProcessor *this)
+{
+    uint16_t pc = this->state.pc;
+    uint16_t last = this->idle.lastPC;
+    bool looped = (pc < last && last - pc <= kGBIdleLoopMaxSize);
+
+    this->idle.lastPC = pc;
+
+    if (looped && (pc != this->idle.head || last != this->idle.end))
+    {
+        this->idle.head = pc;
+        this->idle.end = last;
+        this->idle.armed = false;
+        this->idle.valid = __GBProcessorIdleAnalyze(this, pc, last, &this->idle.reads);
+
+        if (this->idle.valid)
+            this->idle.detections++;
+    }
+
+    if (!this->idle.valid)
+        return false;
+
+    if (pc != this->idle.head)
+    {
+        // Anything outside the loop (like an interrupt) may have written memory the loop reads.
+        if (pc < this->idle.head || pc > this->idle.end)
+            this->idle.armed = false;
+
+        return false;
+    }
+
+    // Only an iteration with nothing else running in between tells us anything.
+    if (looped && this->idle.armed && this->idle.budget > this->idle.cycles && !(*this->mmu->dma))
+    {
+        bool same = (this->idle.a == this->state.a && this->idle.f == GBProcessorReadFlags(this) &&
+                     this->idle.bc == this->state.bc && this->idle.de == this->state.de &&
+                     this->idle.hl == this->state.hl && this->idle.sp == this->state.sp);
+
+        if (!same)
+        {
+            // Something like a counter. It isn't waiting on anything.
+            this->idle.valid = false;
+
+            return false;
+        }
+
+        // Every iteration until the next event reads the same values and ends up right back here.
+        uint32_t budget = (this->budget < UINT16_MAX) ? this->budget : UINT16_MAX;
+        uint32_t iterations = budget / this->idle.cycles;
+
+        if (iterations && __GBProcessorIdleReadsAreStable(this))
+        {
+            this->state.cycles = iterations * this->idle.cycles;
+
+            this->idle.skips++;
+            this->idle.skippedTicks += this->state.cycles;
+            this->idle.armed = false;
+
+            return true;
+        }
+    }
+
+    __GBProcessorIdleArm(this);
+
+    return false;
+}
+
+#pragma mark - Fast Core
+
+static void __GBProcessorFastInterrupt(GBProcessor *this)
+{
+    if (this->ic->interruptPending && !GBInterruptControllerCheck(this->ic))
+    {
+        printf("Interrupt Cancelled.\n");
+
+        this->state.mode = kGBProcessorModeFetch;
+        this->ic->interruptPending = false;
+
+        return;
+    }
+
+    GBInterruptControllerReset(this->ic);
+
+    // Store PC (high byte, then low byte), stall twice, then jump to the vector
+    __GBProcessorWrite(this, this->state.sp - 1, this->state.pc >> 8);
+    __GBProcessorFastAccess(this);
+
+    __GBProcessorWrite(this, this->state.sp - 2, this->state.pc & 0xFF);
+    __GBProcessorFastAccess(this);
+
+    this->state.pc = this->ic->destination;
+    this->state.sp -= 2;
+
+    this->state.ime = false;
+    this->state.cycles += 2 * kGBProcessorAccessCycles;
+
+    this->state.mode = kGBProcessorModeFetch;
+}
+
+void __GBProcessorFastDecode(GBProcessor *this)
+{
+    if (this->cache && GBProcessorDecodeCacheFetch(this->cache, this))
+        return;
+
+    __GBProcessorRead(this, this->state.pc++);
+    __GBProcessorFastAccess(this);
+
+    if (this->state.mdr == 0xCB) {
+        this->state.prefix = true;
+
+        __GBProcessorRead(this, this->state.pc++);
+        __GBProcessorFastAccess(this);
+
+        this->state.mode = kGBProcessorModePrefix;
+    } else {
+        this->state.prefix = false;
+        this->state.mode = kGBProcessorModeRun;
+    }
+
+    this->state.op = this->state.mdr;
+}
+
+bool __GBProcessorFastFetch(GBProcessor *this)
+{
+    this->idle.cycles += this->state.cycles;
+    this->state.cycles = 0;
+
+    switch (this->state.mode)
+    {
+        case kGBProcessorModeHalted: {
+            if (GBInterruptControllerCheck(this->ic))
+            {
+                if (this->state.enableIME) {
+                    this->state.mode = kGBProcessorModeInterrupted;
+                    this->state.data = 0;
+                } else {
+                    this->state.mode = kGBProcessorModeFetch;
+                }
+            }
+        } break;
+        case kGBProcessorModeFetch: {
+            // The micro-stepped core looks for interrupts on the tick the last instruction finished.
+            this->ic->tick(this->ic, 0);
+
+            if (this->state.enableIME)
+            {
+                this->state.enableIME = false;
+                this->state.ime = true;
+            }
+
+            if (this->ic->interruptPending)
+            {
+                __GBProcessorFastInterrupt(this);
+
+                break;
+            }
+
+            if (this->idle.enabled && __GBProcessorIdleSkip(this))
+                break;
+
+            // Translated code runs as many instructions as it can before anything else is due.
+            // Idle loops stay on the interpreter so we see every pass through them.
+            bool idle = (this->idle.valid && this->state.pc >= this->idle.head && this->state.pc <= this->idle.end);
+
+            if (this->jit && this->jit->enabled && !idle && GBProcessorJITRun(this->jit, this))
+                break;
+
+            __GBProcessorFastDecode(this);
+
+            return true;
+        } break;
+        case kGBProcessorModeInterrupted: {
+            __GBProcessorFastInterrupt(this);
+        } break;
+        default: break;
+    }
+
+    return false;
+}
+
+uint16_t GBProcessorFastStep(GBProcessor *this)
+{
+    if (!__GBProcessorFastFetch(this))
+        return this->state.cycles;
+
+    // Ops are still state machines, but every step finds the access it is waiting on already done.
+    while (this->state.mode > kGBProcessorModeFetch)
+    {
+        GBDispatchOP(this);
+        __GBProcessorFastAccess(this);
+    }
+
+    return this->state.cycles;
+}
+
+void __GBProcessorFastTick(GBProcessor *this, uint64_t tick)
+{
+    GBProcessorFastStep(this);
+}
+
+uint64_t __GBProcessorFastNextEvent(GBProcessor *this, uint64_t tick)
+{
+    if (this->state.mode == kGBProcessorModeOff || this->state.mode == kGBProcessorModeStopped)
+        return kGBClockNever;
+
+    // Still halted after checking for interrupts. Sleep until the clock sees another component raise one.
+    if (this->state.mode == kGBProcessorModeHalted && !this->state.cycles && !GBInterruptControllerCheck(this->ic))
+        return kGBClockNever;
+
+    if (!this->state.cycles)
+        return tick + 1;
+
+    return tick + this->state.cycles;
+}
@@ -0,0 +1,339 @@
+#include <libgb/gameboy.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#pragma mark - Instruction Lengths
+
+#define op(code, len, str, impl)        enum { __GBDecodeCacheLength_ ## code = len }
+#define op_pre(code, len, str, impl)    enum { __GBDecodeCacheLength_pre_ ## code = len }
+
+#define kGBInstructionSetOpsOnly 1
+#include "指令集.h"
+#undef kGBInstructionSetOpsOnly
+
+#undef op
+#undef op_pre
+
+#define expand(v)                                                                                               \
+    __GBDecodeCacheLength_ ## v ## 0, __GBDecodeCacheLength_ ## v ## 1, __GBDecodeCacheLength_ ## v ## 2,       \
+    __GBDecodeCacheLength_ ## v ## 3, __GBDecodeCacheLength_ ## v ## 4, __GBDecodeCacheLength_ ## v ## 5,       \
+    __GBDecodeCacheLength_ ## v ## 6, __GBDecodeCacheLength_ ## v ## 7, __GBDecodeCacheLength_ ## v ## 8,       \
+    __GBDecodeCacheLength_ ## v ## 9, __GBDecodeCacheLength_ ## v ## A, __GBDecodeCacheLength_ ## v ## B,       \
+    __GBDecodeCacheLength_ ## v ## C, __GBDecodeCacheLength_ ## v ## D, __GBDecodeCacheLength_ ## v ## E,       \
+    __GBDecodeCacheLength_ ## v ## F
+
+const uint8_t gGBInstructionLengths[0x100] = {
+    expand(0x0), expand(0x1), expand(0x2), expand(0x3),
+    expand(0x4), expand(0x5), expand(0x6), expand(0x7),
+    expand(0x8), expand(0x9), expand(0xA), expand(0xB),
+    expand(0xC), expand(0xD), expand(0xE), expand(0xF)
+};
+
+#undef expand
+
+// Ops after which the next PC isn't (always) the next instruction
+static bool __GBDecodeCacheEndsRun(uint8_t op)
+{
+    switch (op)
+    {
+        case 0x10: case 0x76:
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9:
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+        case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9:
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+        case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4:
+        case 0xEB: case 0xEC: case 0xED: case 0xF4: case 0xFC: case 0xFD:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+#pragma mark - Pools
+
+static bool __GBDecodeCachePoolInit(GBDecodeCachePool *pool, uint32_t opMax, uint32_t runMax)
+{
+    pool->ops = GBAllocate(opMax * sizeof(GBDecodedOP));
+    pool->runs = GBAllocate(runMax * sizeof(GBDecodedRun));
+
+    if (!pool->ops || !pool->runs)
+    {
+        GBRelease(pool->ops);
+        GBRelease(pool->runs);
+
+        return false;
+    }
+
+    pool->opMax = opMax;
+    pool->runMax = runMax;
+
+    return true;
+}
+
+static void __GBDecodeCachePoolFlush(GBDecodeCachePool *pool)
+{
+    pool->opCount = 0;
+    pool->runCount = 0;
+
+    for (uint32_t i = 0; i < kGBDecodeCacheBucketCount; i++)
+        pool->buckets[i] = NULL;
+}
+
+static uint32_t __GBDecodeCacheBucket(uint32_t key)
+{
+    return (key ^ (key >> 11) ^ (key >> 16)) & (kGBDecodeCacheBucketCount - 1);
+}
+
+static void __GBDecodeCacheMark(GBProcessorDecodeCache *this, uint16_t start, uint16_t end)
+{
+    for (uint16_t line = start >> kGBDecodeCacheLineShift; line <= (end >> kGBDecodeCacheLineShift); line++)
+        this->codeMap[line >> 3] |= (1 << (line & 7));
+}
+
+#pragma mark - Runs
+
+// Find which pool a PC belongs to and how far a run from it may go. Returns false for memory we don't cache.
+static bool __GBDecodeCacheKey(GBProcessorDecodeCache *this, GBMemoryManager *mmu, uint16_t pc, uint32_t *key, uint16_t *end, GBDecodeCachePool **pool)
+{
+    (*pool) = &this->romPool;
+
+    if (pc < kGBBIOSROMSize && !(*mmu->romMasked)) {
+        (*key) = kGBDecodeCacheKeyBIOS | pc;
+        (*end) = kGBBIOSROMSize - 1;
+    } else if (pc <= kGBCartROMBankLowEnd) {
+        (*key) = this->rom ? ((this->rom->lowBank << 16) | pc) : pc;
+        (*end) = kGBCartROMBankLowEnd;
+    } else if (pc <= kGBCartROMBankHighEnd) {
+        if (!this->rom)
+            return false;
+
+        (*key) = (this->rom->bank << 16) | pc;
+        (*end) = kGBCartROMBankHighEnd;
+    } else {
+        (*pool) = &this->ramPool;
+        (*key) = kGBDecodeCacheKeyRAM | pc;
+
+        if (pc >= kGBWorkRAMStart && pc <= kGBWorkRAMEnd) {
+            (*end) = kGBWorkRAMEnd;
+        } else if (pc >= kGBHighRAMStart && pc <= kGBHighRAMEnd) {
+            (*end) = kGBHighRAMEnd;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static GBDecodedRun *__GBDecodeCacheBuild(GBProcessorDecodeCache *this, GBMemoryManager *mmu, GBDecodeCachePool *pool, uint32_t key, uint16_t end)
+{
+    if (pool->runCount == pool->runMax || pool->opCount + kGBDecodeCacheMaxRun > pool->opMax)
+    {
+        // Whatever we were running may be gone now
+        __GBDecodeCachePoolFlush(pool);
+        this->next = NULL;
+
+        if (pool == &this->ramPool)
+            bzero(this->codeMap, kGBDecodeCacheMapSize);
+    }
+
+    GBDecodedOP *ops = pool->ops + pool->opCount;
+    uint16_t start = key & 0xFFFF;
+    uint32_t pc = start;
+    uint8_t count = 0;
+
+    while (count < kGBDecodeCacheMaxRun)
+    {
+        uint8_t op = __GBMemoryManagerRead(mmu, pc);
+        bool prefix = (op == 0xCB);
+        uint8_t length = prefix ? 2 : gGBInstructionLengths[op];
+
+        if (pc + length - 1 > end)
+            break;
+
+        if (prefix)
+            op = __GBMemoryManagerRead(mmu, pc + 1);
+
+        ops[count].key = (key & 0xFFFF0000) | pc;
+        ops[count].op = op;
+        ops[count].prefix = prefix;
+        ops[count].last = false;
+
+        count++;
+        pc += length;
+
+        if (!prefix && __GBDecodeCacheEndsRun(op))
+            break;
+    }
+
+    if (!count)
+        return NULL;
+
+    ops[count - 1].last = true;
+    pool->opCount += count;
+
+    if (pool == &this->ramPool)
+        __GBDecodeCacheMark(this, start, pc - 1);
+
+    GBDecodedRun *run = &pool->runs[pool->runCount++];
+    uint32_t bucket = __GBDecodeCacheBucket(key);
+
+    run->key = key;
+    run->ops = ops;
+    run->next = pool->buckets[bucket];
+    pool->buckets[bucket] = run;
+
+    return run;
+}
+
+#pragma mark - Decode Cache
+
+GBProcessorDecodeCache *GBProcessorDecodeCacheCreate(void)
+{
+    GBProcessorDecodeCache *cache = GBAllocate(sizeof(GBProcessorDecodeCache));
+
+    if (cache)
+    {
+        if (!__GBDecodeCachePoolInit(&cache->romPool, kGBDecodeCacheROMOps, kGBDecodeCacheROMRuns))
+        {
+            GBRelease(cache);
+
+            return NULL;
+        }
+
+        if (!__GBDecodeCachePoolInit(&cache->ramPool, kGBDecodeCacheRAMOps, kGBDecodeCacheRAMRuns))
+        {
+            GBRelease(cache->romPool.ops);
+            GBRelease(cache->romPool.runs);
+            GBRelease(cache);
+
+            return NULL;
+        }
+
+        cache->rom = NULL;
+
+        cache->hits = 0;
+        cache->misses = 0;
+        cache->uncached = 0;
+        cache->invalidations = 0;
+
+        GBProcessorDecodeCacheFlush(cache);
+    }
+
+    return cache;
+}
+
+void GBProcessorDecodeCacheDestroy(GBProcessorDecodeCache *this)
+{
+    GBRelease(this->romPool.ops);
+    GBRelease(this->romPool.runs);
+
+    GBRelease(this->ramPool.ops);
+    GBRelease(this->ramPool.runs);
+
+    GBRelease(this);
+}
+
+void GBProcessorDecodeCacheFlush(GBProcessorDecodeCache *this)
+{
+    __GBDecodeCachePoolFlush(&this->romPool);
+    __GBDecodeCachePoolFlush(&this->ramPool);
+
+    bzero(this->codeMap, kGBDecodeCacheMapSize);
+    this->next = NULL;
+}
+
+bool GBProcessorDecodeCacheFetch(GBProcessorDecodeCache *this, GBProcessor *cpu)
+{
+    GBMemoryManager *mmu = cpu->mmu;
+
+    if (mmu->codeWritten)
+    {
+        __GBDecodeCachePoolFlush(&this->ramPool);
+        bzero(this->codeMap, kGBDecodeCacheMapSize);
+
+        if (this->next && (this->next->key & kGBDecodeCacheKeyRAM))
+            this->next = NULL;
+
+        mmu->codeWritten = false;
+        this->invalidations++;
+    }
+
+    // Fetches during DMA read 0xFF (except from high RAM). Leave that to the memory manager.
+    if (*mmu->dma)
+    {
+        this->uncached++;
+
+        return false;
+    }
+
+    uint16_t pc = cpu->state.pc;
+    GBDecodeCachePool *pool;
+    uint32_t key;
+    uint16_t end;
+
+    if (!__GBDecodeCacheKey(this, mmu, pc, &key, &end, &pool))
+    {
+        this->next = NULL;
+        this->uncached++;
+
+        return false;
+    }
+
+    GBDecodedOP *op = this->next;
+
+    if (!op || op->key != key)
+    {
+        GBDecodedRun *run = pool->buckets[__GBDecodeCacheBucket(key)];
+
+        while (run && run->key != key)
+            run = run->next;
+
+        if (run) {
+            this->hits++;
+        } else {
+            run = __GBDecodeCacheBuild(this, mmu, pool, key, end);
+
+            if (!run)
+            {
+                this->uncached++;
+
+                return false;
+            }
+
+            this->misses++;
+        }
+
+        op = run->ops;
+    } else {
+        this->hits++;
+    }
+
+    this->next = op->last ? NULL : op + 1;
+
+    // Leave the processor exactly as the fetch over the bus would have
+    if (op->prefix) {
+        cpu->state.mar = pc + 1;
+        cpu->state.pc = pc + 2;
+        cpu->state.cycles += 2 * kGBProcessorAccessCycles;
+
+        cpu->state.mode = kGBProcessorModePrefix;
+    } else {
+        cpu->state.mar = pc;
+        cpu->state.pc = pc + 1;
+        cpu->state.cycles += kGBProcessorAccessCycles;
+
+        cpu->state.mode = kGBProcessorModeRun;
+    }
+
+    cpu->state.accessed = true;
+    cpu->state.mdr = op->op;
+
+    cpu->state.prefix = op->prefix;
+    cpu->state.op = op->op;
+
+    return true;
+}
@@ -0,0 +1,90 @@
+#include <libgb/diag.h>
+#include <stdatomic.h>
+
+typedef struct {
+    const char *name;
+    const char *message; // Logged on the first hit of each address (NULL to stay quiet)
+} GBDiagnosticKind;
+
+static const GBDiagnosticKind gGBDiagnosticKinds[kGBDiagnosticCount] = {
+    [kGBDiagnosticUnmappedRead]  = { "unmapped reads",      "Warning: Attempted read to unmapped address '0x%04X'\n" },
+    [kGBDiagnosticUnmappedWrite] = { "unmapped writes",     "Warning: Attempted write to unmapped address '0x%04X'\n" },
+    [kGBDiagnosticPortRead]      = { "missing port reads",  "Warning: Attempt to read byte from nonexistant I/O Port '0x%04X'\n" },
+    [kGBDiagnosticPortWrite]     = { "missing port writes", NULL },
+    [kGBDiagnosticPortRange]     = { "out of range I/O",    "Warning: Attempted access to I/O port at memory address out of range! (addr=0x%04X)\n" },
+    [kGBDiagnosticROMWrite]      = { "ROM writes",          "Warning: Attempting to write directly to ROM! (addr=0x%04X)\n" },
+    [kGBDiagnosticBIOSWrite]     = { "BIOS writes",         "Warning: Write to BIOS ROM! (addr=0x%04X)\n" }
+};
+
+static _Atomic uint64_t gGBDiagnosticCounts[kGBDiagnosticCount];
+static _Atomic uint32_t gGBDiagnosticAddresses[kGBDiagnosticCount];
+
+// One bit per address for each kind
+static _Atomic uint32_t gGBDiagnosticSeen[kGBDiagnosticCount][0x10000 / 32];
+
+#pragma mark - Counters
+
+void GBDiagnosticsRecord(uint8_t kind, uint16_t address)
+{
+    atomic_fetch_add_explicit(&gGBDiagnosticCounts[kind], 1, memory_order_relaxed);
+
+    _Atomic uint32_t *seen = &gGBDiagnosticSeen[kind][address >> 5];
+    uint32_t bit = 1U << (address & 0x1F);
+
+    // Plain load first so repeat hits never write the shared line
+    if (atomic_load_explicit(seen, memory_order_relaxed) & bit)
+        return;
+
+    if (atomic_fetch_or_explicit(seen, bit, memory_order_relaxed) & bit)
+        return;
+
+    atomic_fetch_add_explicit(&gGBDiagnosticAddresses[kind], 1, memory_order_relaxed);
+
+    if (gGBDiagnosticKinds[kind].message)
+        fprintf(stderr, gGBDiagnosticKinds[kind].message, address);
+}
+
+uint64_t GBDiagnosticsCount(uint8_t kind)
+{
+    return atomic_load_explicit(&gGBDiagnosticCounts[kind], memory_order_relaxed);
+}
+
+uint32_t GBDiagnosticsAddressCount(uint8_t kind)
+{
+    return atomic_load_explicit(&gGBDiagnosticAddresses[kind], memory_order_relaxed);
+}
+
+#pragma mark - Summary
+
+void GBDiagnosticsDump(FILE *stream)
+{
+    bool any = false;
+
+    for (uint8_t kind = 0; kind < kGBDiagnosticCount; kind++)
+    {
+        uint64_t count = GBDiagnosticsCount(kind);
+
+        if (!count)
+            continue;
+
+        if (!any)
+        {
+            fprintf(stream, "Diagnostics:\n");
+            any = true;
+        }
+
+        fprintf(stream, "    %-20s %llu (at %u addresses)\n", gGBDiagnosticKinds[kind].name, (unsigned long long)count, GBDiagnosticsAddressCount(kind));
+    }
+}
+
+void GBDiagnosticsReset(void)
+{
+    for (uint8_t kind = 0; kind < kGBDiagnosticCount; kind++)
+    {
+        atomic_store_explicit(&gGBDiagnosticCounts[kind], 0, memory_order_relaxed);
+        atomic_store_explicit(&gGBDiagnosticAddresses[kind], 0, memory_order_relaxed);
+
+        for (uint32_t i = 0; i < (0x10000 / 32); i++)
+            atomic_store_explicit(&gGBDiagnosticSeen[kind][i], 0, memory_order_relaxed);
+    }
+}
@@ -1,10 +1,11 @@
 #include <libgb/gameboy.h>
+#include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
 GBDMARegister *GBDMARegisterCreate(void)
 {
-    GBDMARegister *port = malloc(sizeof(GBDMARegister));
+    GBDMARegister *port = GBAllocate(sizeof(GBDMARegister));
 
     if (port)
     {
@@ -20,8 +21,13 @@ GBDMARegister *GBDMARegisterCreate(void)
         port->offset = 0;
         port->ticks = 0;
 
+        port->lastTick = 0;
+        port->paused = false;
+        port->bulk = false;
+
         port->install = __GBDMARegisterInstall;
         port->tick = __GBDMARegisterTick;
+        port->nextEvent = __GBDMARegisterNextEvent;
     }
 
     return port;
@@ -29,7 +35,7 @@ GBDMARegister *GBDMARegisterCreate(void)
 
 void GBDMARegisterDestroy(GBDMARegister *this)
 {
-    free(this);
+    GBRelease(this);
 }
 
 void __GBDMARegisterWrite(GBDMARegister *this, uint8_t byte)
@@ -41,29 +47,73 @@ void __GBDMARegisterWrite(GBDMARegister *this, uint8_t byte)
     this->startAddress = (((uint16_t)byte) << 8);
     this->offset = 0;
     this->ticks = 0;
+
+    // The transfer starts counting on the tick it was written
+    this->lastTick = this->clock->internalTick - 1;
+    this->paused = false;
 }
 
 bool __GBDMARegisterInstall(GBDMARegister *this, struct __GBGameboy *gameboy)
 {
     gameboy->cpu->mmu->dma = &this->inProgress;
+    this->clock = gameboy->clock;
     this->cpu = gameboy->cpu;
+    this->oam = gameboy->driver->oam;
+
+    this->bulk = (gameboy->cpu->core != kGBProcessorCoreMicro);
 
     GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this);
 
     return true;
 }
 
+static void __GBDMARegisterCopy(GBDMARegister *this)
+{
+    GBMemoryManager *mmu = this->cpu->mmu;
+    uint8_t *destination = (uint8_t *)this->oam->memory;
+
+    // The source never crosses a page, so a mapped page is copied straight across
+    uint8_t *page = mmu->readPages[this->startAddress >> kGBMemoryPageShift];
+
+    if (page) {
+        memcpy(destination, page + (this->startAddress & (kGBMemoryPageSize - 1)), kGBDMARegisterLength);
+    } else {
+        for (uint8_t i = 0; i < kGBDMARegisterLength; i++)
+            destination[i] = __GBMemoryManagerRead(mmu, this->startAddress + i);
+    }
+}
+
 void __GBDMARegisterTick(GBDMARegister *this, uint64_t ticks)
 {
-    // DMA is paused during halt and stop modes.
-    if (this->cpu->state.mode == kGBProcessorModeHalted || this->cpu->state.mode == kGBProcessorModeStopped)
+    if (!this->inProgress)
         return;
 
-    if (!this->inProgress)
+    // Make up for the ticks we weren't run on. The processor mode can't have changed in between (we're always run when it runs).
+    if (!this->paused)
+        this->ticks += ticks - this->lastTick - 1;
+
+    this->lastTick = ticks;
+
+    // DMA is paused during halt and stop modes.
+    this->paused = (this->cpu->state.mode == kGBProcessorModeHalted || this->cpu->state.mode == kGBProcessorModeStopped);
+
+    if (this->paused)
         return;
 
     this->ticks++;
 
+    if (this->bulk)
+    {
+        if (this->ticks >= kGBDMARegisterEndClocks)
+        {
+            __GBDMARegisterCopy(this);
+
+            this->inProgress = false;
+        }
+
+        return;
+    }
+
     if (!(this->ticks % 4))
     {
         if (this->ticks > kGBDMARegisterTotalClocks) {
@@ -84,3 +134,17 @@ void __GBDMARegisterTick(GBDMARegister *this, uint64_t ticks)
         }
     }
 }
+
+uint64_t __GBDMARegisterNextEvent(GBDMARegister *this, uint64_t ticks)
+{
+    // A paused transfer is picked back up when the processor runs again.
+    if (!this->inProgress || this->paused)
+        return kGBClockNever;
+
+    // A bulk transfer only has to be run again when it ends
+    if (this->bulk)
+        return ticks + (kGBDMARegisterEndClocks - this->ticks);
+
+    // Bytes move every 4 ticks
+    return ticks + (4 - (this->ticks % 4));
+}
@@ -1,11 +1,17 @@
 #include <libgb/gameboy.h>
 #include <strings.h>
+#include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
 GBGameboy *GBGameboyCreate(void)
 {
-    GBGameboy *gameboy = malloc(sizeof(GBGameboy));
+    return GBGameboyCreateWithCore(kGBProcessorCoreMicro);
+}
+
+GBGameboy *GBGameboyCreateWithCore(uint8_t core)
+{
+    GBGameboy *gameboy = GBAllocate(sizeof(GBGameboy));
 
     if (gameboy)
     {
@@ -15,37 +21,41 @@ GBGameboy *GBGameboyCreate(void)
         gameboy->cartInstalled = false;
         gameboy->biosInstalled = false;
 
-        gameboy->cpu = GBProcessorCreate();
+        // Made in the order they're used on every tick. In an arena this keeps the hot components together (and the big memories after them).
+        gameboy->clock = GBClockCreate();
+        success &= !!gameboy->clock;
+
+        gameboy->cpu = GBProcessorCreate(core);
         success &= !!gameboy->cpu;
 
-        gameboy->driver = GBGraphicsDriverCreate();
-        success &= !!gameboy->driver;
+        gameboy->dma = GBDMARegisterCreate();
+        success &= !!gameboy->dma;
+
+        gameboy->gamepad = GBGamepadCreate();
+        success &= !!gameboy->gamepad;
 
         gameboy->mmio = GBIOMapperCreate();
         success &= !!gameboy->mmio;
 
+        gameboy->driver = GBGraphicsDriverCreate();
+        success &= !!gameboy->driver;
+
         gameboy->wram = GBWorkRAMCreate();
         success &= !!gameboy->wram;
 
         gameboy->vram = GBVideoRAMCreate();
         success &= !!gameboy->vram;
 
-        gameboy->gamepad = GBGamepadCreate();
-        success &= !!gameboy->gamepad;
-
-        gameboy->dma = GBDMARegisterCreate();
-        success &= !!gameboy->dma;
-
-        gameboy->clock = GBClockCreate();
-        success &= !!gameboy->clock;
-
         if (!success)
         {
+            if (gameboy->clock)
+                GBClockDestroy(gameboy->clock);
+
             if (gameboy->dma)
                 GBDMARegisterDestroy(gameboy->dma);
 
             if (gameboy->gamepad)
-                free(gameboy->gamepad);
+                GBRelease(gameboy->gamepad);
 
             if (gameboy->wram)
                 GBWorkRAMDestroy(gameboy->wram);
@@ -62,6 +72,8 @@ GBGameboy *GBGameboyCreate(void)
             if (gameboy->cpu)
                 GBProcessorDestroy(gameboy->cpu);
 
+            GBRelease(gameboy);
+
             return NULL;
         }
 
@@ -86,6 +98,7 @@ GBGameboy *GBGameboyCreate(void)
             GBIOMapperDestroy(gameboy->mmio);
             GBGraphicsDriverDestroy(gameboy->driver);
             GBProcessorDestroy(gameboy->cpu);
+            GBRelease(gameboy);
 
             return NULL;
         }
@@ -94,6 +107,145 @@ GBGameboy *GBGameboyCreate(void)
     return gameboy;
 }
 
+GBGameboy *GBGameboyCreateInArena(uint8_t core)
+{
+    GBArena *arena = GBArenaCreate(kGBArenaReserve);
+
+    if (!arena)
+        return NULL;
+
+    GBArena *previous = GBArenaGetCurrent();
+    GBArenaSetCurrent(arena);
+
+    GBGameboy *gameboy = GBGameboyCreateWithCore(core);
+
+    GBArenaSetCurrent(previous);
+
+    if (!gameboy)
+    {
+        GBArenaDestroy(arena);
+
+        return NULL;
+    }
+
+    GBArenaTrim(arena);
+    gameboy->arena = arena;
+
+    return gameboy;
+}
+
+void GBGameboyDestroy(GBGameboy *this)
+{
+    if (this->arena)
+    {
+        // The JIT is only ever turned on later, so it's the one thing outside
+        if (this->cpu->jit)
+            GBProcessorJITDestroy(this->cpu->jit);
+
+        GBArenaDestroy(this->arena);
+
+        return;
+    }
+
+    GBClockDestroy(this->clock);
+    GBDMARegisterDestroy(this->dma);
+    GBGamepadDestroy(this->gamepad);
+    GBWorkRAMDestroy(this->wram);
+    GBVideoRAMDestroy(this->vram);
+    GBIOMapperDestroy(this->mmio);
+    GBGraphicsDriverDestroy(this->driver);
+    GBProcessorDestroy(this->cpu);
+
+    GBRelease(this);
+}
+
+#pragma mark - Snapshots
+
+// The cart and BIOS live outside the arena. A snapshot keeps which ones it was taken with and their state after the arena image.
+typedef struct {
+    GBCartridge *cart;
+    GBBIOSROM *bios;
+    bool biosMasked;
+} __GBGameboySnapshotExtra;
+
+size_t GBGameboySnapshotSize(GBGameboy *this)
+{
+    if (!this->arena)
+        return 0;
+
+    return this->arena->used + sizeof(__GBGameboySnapshotExtra) + (this->cart ? GBCartridgeStateSize(this->cart) : 0);
+}
+
+bool GBGameboySnapshot(GBGameboy *this, void *buffer)
+{
+    if (!this->arena)
+        return false;
+
+    uint8_t *extraStart = (uint8_t *)buffer + this->arena->used;
+    __GBGameboySnapshotExtra extra;
+    bzero(&extra, sizeof(extra));
+
+    extra.cart = this->cart;
+    extra.bios = this->bios;
+    extra.biosMasked = this->bios ? this->bios->masked : false;
+
+    memcpy(buffer, this->arena->base, this->arena->used);
+    memcpy(extraStart, &extra, sizeof(extra));
+
+    if (this->cart)
+        GBCartridgeSaveState(this->cart, extraStart + sizeof(extra));
+
+    return true;
+}
+
+bool GBGameboyRestoreSnapshot(GBGameboy *this, const void *buffer)
+{
+    if (!this->arena)
+        return false;
+
+    const uint8_t *extraStart = (const uint8_t *)buffer + this->arena->used;
+    __GBGameboySnapshotExtra extra;
+    memcpy(&extra, extraStart, sizeof(extra));
+
+    // Only the state of the cart and BIOS is in the snapshot, so it has to go back into the same ones
+    if (extra.cart != this->cart || extra.bios != this->bios)
+        return false;
+
+    // These point outside the arena, and stay as they are now
+    GBProcessorJIT *jit = this->cpu->jit;
+    GBGameboyInstructionHook hook = this->instructionHook;
+    void *hookContext = this->hookContext;
+    GBCartridge *cart = this->cart;
+
+    // Which renderer to use is a setting rather than state
+    bool scanline = this->driver->scanlineNext;
+
+    memcpy(this->arena->base, buffer, this->arena->used);
+
+    this->cpu->jit = jit;
+    this->instructionHook = hook;
+    this->hookContext = hookContext;
+    this->cart = cart;
+
+    // The overlay on page 0 follows the mask (before the cart maps under it)
+    if (this->bios)
+    {
+        this->bios->masked = extra.biosMasked;
+
+        GBMemoryManagerMapBIOS(this->cpu->mmu, this->bios->masked ? NULL : this->bios->data);
+    }
+
+    if (this->cart)
+        GBCartridgeRestoreState(this->cart, extraStart + sizeof(extra));
+
+    GBGraphicsDriverSetScanline(this->driver, scanline);
+
+    // The screen jumped to the snapshot's, which nothing has shown yet
+    GBGraphicsDriverDamageAll(this->driver);
+
+    return true;
+}
+
 #pragma mark - Power State Functions
 
 bool GBGameboyIsPoweredOn(GBGameboy *this)
@@ -112,7 +264,11 @@ void GBGameboyPowerOff(GBGameboy *this)
 void GBGameboyPowerOn(GBGameboy *this)
 {
     if (this->cpu->state.mode == kGBProcessorModeOff)
+    {
         this->cpu->state.mode = kGBProcessorModeFetch;
+
+        GBClockSchedule(this->clock, kGBClockEventProcessor, this->clock->internalTick + 1);
+    }
 }
 
 #pragma mark - BIOS Utility Functions
@@ -138,10 +294,177 @@ void GBGameboyMaskBIOS(GBGameboy *this, GBBIOSROM *bios)
 
 bool GBGameboyInsertCartridge(GBGameboy *this, GBCartridge *cart)
 {
-    return GBCartridgeMap(cart, this);
+    if (!GBCartridgeMap(cart, this))
+        return false;
+
+    this->cart = cart;
+    this->cartInstalled = true;
+
+    if (this->cpu->cache)
+    {
+        GBProcessorDecodeCacheFlush(this->cpu->cache);
+        this->cpu->cache->rom = cart->rom;
+    }
+
+    if (this->cpu->jit)
+    {
+        GBProcessorJITFlush(this->cpu->jit);
+        this->cpu->jit->rom = cart->rom;
+    }
+
+    return true;
 }
 
 bool GBGameboyEjectCartridge(GBGameboy *this, GBCartridge *cart)
 {
-    return GBCartridgeUnmap(cart, this);
+    if (!GBCartridgeUnmap(cart, this))
+        return false;
+
+    this->cart = NULL;
+    this->cartInstalled = false;
+
+    if (this->cpu->cache)
+    {
+        GBProcessorDecodeCacheFlush(this->cpu->cache);
+        this->cpu->cache->rom = NULL;
+    }
+
+    if (this->cpu->jit)
+    {
+        GBProcessorJITFlush(this->cpu->jit);
+        this->cpu->jit->rom = NULL;
+    }
+
+    return true;
+}
+
+#pragma mark - Running
+
+// Stop at every instruction fetch so the hook can look at it first.
+static uint64_t __GBGameboyRunHooked(GBGameboy *this, uint64_t cycles)
+{
+    GBClock *clock = this->clock;
+    GBProcessor *cpu = this->cpu;
+
+    uint64_t start = clock->internalTick;
+    uint64_t end = start + cycles;
+
+    while (clock->internalTick < end)
+    {
+        uint64_t now = clock->internalTick;
+        uint64_t due = clock->events[kGBClockEventProcessor];
+        uint64_t next = now + 1;
+
+        // Run everything up to the tick before the processor is due in one go.
+        // A sleeping processor can wake up on any tick, so it's stepped one at a time.
+        if (due > next && due != kGBClockNever)
+            next = due - 1;
+
+        if (next > end)
+            next = end;
+
+        if (due <= now + 1 && cpu->state.mode == kGBProcessorModeFetch)
+        {
+            if (!this->instructionHook(this, this->hookContext))
+                break;
+        }
+
+        if (GBClockAdvance(clock, next - now) < next - now)
+            break;
+
+        // A step can end right on the frame limit, so the short return above doesn't always catch it
+        if (this->driver->frameCount >= clock->frameLimit)
+            break;
+    }
+
+    return clock->internalTick - start;
+}
+
+static void __GBGameboyFlushSave(GBGameboy *this)
+{
+    if (this->clock->internalTick - this->saveFlushTick < kGBGameboySaveFlushTicks)
+        return;
+
+    this->saveFlushTick = this->clock->internalTick;
+
+    if (this->cart && this->cart->ram)
+        GBCartRAMFlush(this->cart->ram, false);
+}
+
+uint64_t GBGameboyRunCycles(GBGameboy *this, uint64_t cycles)
+{
+    if (!GBGameboyIsPoweredOn(this))
+        return 0;
+
+    uint64_t ticks;
+
+    if (this->instructionHook) {
+        ticks = __GBGameboyRunHooked(this, cycles);
+    } else {
+        ticks = GBClockAdvance(this->clock, cycles);
+    }
+
+    __GBGameboyFlushSave(this);
+
+    return ticks;
+}
+
+uint64_t GBGameboyRunFrame(GBGameboy *this)
+{
+    // A frame always ends within one frame's worth of ticks, wherever the driver is now.
+    this->clock->frameLimit = this->driver->frameCount + 1;
+
+    uint64_t ticks = GBGameboyRunCycles(this, kGBDriverFrameClocks);
+
+    this->clock->frameLimit = kGBClockNever;
+
+    return ticks;
+}
+
+void GBGameboySetInstructionHook(GBGameboy *this, GBGameboyInstructionHook hook, void *context)
+{
+    this->instructionHook = hook;
+    this->hookContext = context;
+}
+
+#pragma mark - JIT
+
+bool GBGameboySetJITEnabled(GBGameboy *this, bool enabled)
+{
+    if (!enabled)
+    {
+        if (this->cpu->jit)
+            this->cpu->jit->enabled = false;
+
+        return true;
+    }
+
+    // The micro-stepped core never runs whole instructions
+    if (this->cpu->core == kGBProcessorCoreMicro)
+        return false;
+
+    if (!this->cpu->jit)
+    {
+        this->cpu->jit = GBProcessorJITCreate();
+
+        if (!this->cpu->jit)
+            return false;
+
+        this->cpu->jit->rom = this->cart ? this->cart->rom : NULL;
+    }
+
+    this->cpu->jit->enabled = true;
+
+    return true;
+}
+
+bool GBGameboySetJITVerify(GBGameboy *this, bool verify)
+{
+    if (!this->cpu->jit)
+        return false;
+
+    // Blocks are checked as they run, so the ones already translated don't need to be redone
+    this->cpu->jit->verify = verify;
+
+    return true;
 }
@@ -4,7 +4,7 @@
 
 GBGamepad *GBGamepadCreate(void)
 {
-    GBGamepad *gamepad = malloc(sizeof(GBGamepad));
+    GBGamepad *gamepad = GBAllocate(sizeof(GBGamepad));
 
     if (gamepad)
     {
@@ -16,6 +16,7 @@ GBGamepad *GBGamepadCreate(void)
         gamepad->write = __GBGamepadWrite;
 
         gamepad->value = 0xCF;
+        gamepad->gameboy = NULL;
         gamepad->install = __GBGamepadInstall;
     }
 
@@ -27,7 +28,22 @@ void GBGamepadSetKeyState(GBGamepad *this, uint8_t key, bool pressed)
     this->pressed[key >> 2][key & 0x3] = pressed;
 
     if (pressed)
-        (*this->interruptFlag) &= (1 << kGBInterruptJoypad);
+    {
+        (*this->interruptFlag) |= (1 << kGBInterruptJoypad);
+
+        if (!this->gameboy)
+            return;
+
+        // Stop mode only ends on a key press. A stopped or sleeping halted processor isn't scheduled, so run it next tick.
+        GBProcessor *cpu = this->gameboy->cpu;
+        GBClock *clock = this->gameboy->clock;
+
+        if (cpu->state.mode == kGBProcessorModeStopped)
+            cpu->state.mode = kGBProcessorModeFetch;
+
+        if (clock->events[kGBClockEventProcessor] == kGBClockNever && cpu->state.mode != kGBProcessorModeOff)
+            clock->events[kGBClockEventProcessor] = clock->internalTick + 1;
+    }
 }
 
 bool GBGamepadIsKeyDown(GBGamepad *this, uint8_t key)
@@ -37,7 +53,7 @@ bool GBGamepadIsKeyDown(GBGamepad *this, uint8_t key)
 
 void GBGamepadDestroy(GBGamepad *this)
 {
-    free(this);
+    GBRelease(this);
 }
 
 void __GBGamepadWrite(GBGamepad *this, uint8_t byte)
@@ -65,6 +81,7 @@ bool __GBGamepadInstall(GBGamepad *this, struct __GBGameboy *gameboy)
     GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this);
 
     this->interruptFlag = &gameboy->cpu->ic->interruptFlagPort->value;
+    this->gameboy = gameboy;
 
     return true;
 }
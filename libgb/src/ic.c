@@ -5,7 +5,7 @@
 
 GBInterruptFlagPort *GBInterruptFlagPortCreate(void)
 {
-    GBInterruptFlagPort *port = malloc(sizeof(GBInterruptFlagPort));
+    GBInterruptFlagPort *port = GBAllocate(sizeof(GBInterruptFlagPort));
 
     if (port)
     {
@@ -30,7 +30,7 @@ void __GBInterruptFlagPortWrite(GBInterruptFlagPort *port, uint8_t byte)
 
 GBInterruptController *GBInterruptControllerCreate(struct __GBProcessor *cpu)
 {
-    GBInterruptController *ic = malloc(sizeof(GBInterruptController));
+    GBInterruptController *ic = GBAllocate(sizeof(GBInterruptController));
 
     if (ic)
     {
@@ -38,7 +38,7 @@ GBInterruptController *GBInterruptControllerCreate(struct __GBProcessor *cpu)
 
         if (!ic->interruptFlagPort)
         {
-            free(ic);
+            GBRelease(ic);
 
             return NULL;
         }
@@ -75,8 +75,8 @@ void GBInterruptControllerReset(GBInterruptController *this)
 
 void GBInterruptControllerDestroy(GBInterruptController *this)
 {
-    free(this->interruptFlagPort);
-    free(this);
+    GBRelease(this->interruptFlagPort);
+    GBRelease(this);
 }
 
 bool __GBInterruptControllerInstall(GBInterruptController *this, struct __GBGameboy *gameboy)
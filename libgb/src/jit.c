@@ -0,0 +1,959 @@
+#include <libgb/gameboy.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#if kGBJITAvailable
+    #include <sys/mman.h>
+#endif /* kGBJITAvailable */
+
+#if kGBJITAvailable
+
+#pragma mark - Instruction Helpers
+
+#define kGBInstructionSetHelpersOnly 1
+#include "指令集.h"
+#undef kGBInstructionSetHelpersOnly
+
+#undef op
+#undef op_pre
+#undef declare
+#undef op_return
+
+// Same as __GBProcessorFastAccess, but remembers what every write replaced while we check against the interpreter.
+static INLINE void __GBJITAccess(GBProcessor *cpu)
+{
+    GBMemoryManager *mmu = cpu->mmu;
+
+    if (mmu->mar != &cpu->state.mar)
+        return;
+
+    if (mmu->isWrite)
+    {
+        GBProcessorJIT *jit = cpu->jit;
+
+        if (jit->verify && jit->undoCount < kGBJITUndoLogSize)
+        {
+            jit->undo[jit->undoCount].address = cpu->state.mar;
+            jit->undo[jit->undoCount].value = __GBMemoryManagerRead(mmu, cpu->state.mar);
+            jit->undoCount++;
+        }
+
+        mmu->busWritten = true;
+    }
+
+    GBMemoryManagerService(mmu);
+    cpu->state.cycles += kGBProcessorAccessCycles;
+}
+
+#pragma mark - Op Calls
+
+// Ops which aren't generated inline are called from translated code. Each call runs its op to completion.
+#define __GBJITOp(name, start, impl)                                        \
+    static void name(GBProcessor *cpu)                                      \
+    {                                                                       \
+        cpu->state.mode = start;                                            \
+                                                                            \
+        do {                                                                \
+            do impl while (0);                                              \
+                                                                            \
+            __GBJITAccess(cpu);                                             \
+        } while (cpu->state.mode > kGBProcessorModeFetch);                  \
+    }
+
+#define op(code, len, str, impl)                                            \
+    __GBJITOp(__GBJITOp_ ## code, kGBProcessorModeRun, impl)
+
+#define op_pre(code, len, str, impl)                                        \
+    __GBJITOp(__GBJITOp_pre_ ## code, kGBProcessorModePrefix, impl)
+
+#define op_return break
+
+#define kGBInstructionSetOpsOnly 1
+#include "指令集.h"
+#undef kGBInstructionSetOpsOnly
+
+#undef op
+#undef op_pre
+#undef __GBJITOp
+
+typedef void (*GBJITOp)(GBProcessor *cpu);
+
+#define expand(v, p)                                                                                    \
+    __GBJITOp_ ## p ## v ## 0, __GBJITOp_ ## p ## v ## 1, __GBJITOp_ ## p ## v ## 2, __GBJITOp_ ## p ## v ## 3, \
+    __GBJITOp_ ## p ## v ## 4, __GBJITOp_ ## p ## v ## 5, __GBJITOp_ ## p ## v ## 6, __GBJITOp_ ## p ## v ## 7, \
+    __GBJITOp_ ## p ## v ## 8, __GBJITOp_ ## p ## v ## 9, __GBJITOp_ ## p ## v ## A, __GBJITOp_ ## p ## v ## B, \
+    __GBJITOp_ ## p ## v ## C, __GBJITOp_ ## p ## v ## D, __GBJITOp_ ## p ## v ## E, __GBJITOp_ ## p ## v ## F
+
+static const GBJITOp gGBJITOps[0x100] = {
+    expand(0, 0x), expand(1, 0x), expand(2, 0x), expand(3, 0x),
+    expand(4, 0x), expand(5, 0x), expand(6, 0x), expand(7, 0x),
+    expand(8, 0x), expand(9, 0x), expand(A, 0x), expand(B, 0x),
+    expand(C, 0x), expand(D, 0x), expand(E, 0x), expand(F, 0x)
+};
+
+static const GBJITOp gGBJITOpsCB[0x100] = {
+    expand(0x0, pre_),  expand(0x1, pre_), expand(0x2, pre_), expand(0x3, pre_),
+    expand(0x4, pre_),  expand(0x5, pre_), expand(0x6, pre_), expand(0x7, pre_),
+    expand(0x8, pre_),  expand(0x9, pre_), expand(0xA, pre_), expand(0xB, pre_),
+    expand(0xC, pre_),  expand(0xD, pre_), expand(0xE, pre_), expand(0xF, pre_)
+};
+
+#undef expand
+
+#pragma mark - Instruction Classes
+
+enum {
+    kGBJITClassEnd      = 0, // Left to the interpreter. The block ends before it.
+    kGBJITClassInline   = 1, // Generated directly
+    kGBJITClassCall     = 2, // The op is called
+    kGBJITClassBranch   = 3  // The op is called, then the block ends (it set PC)
+};
+
+// Memory an op touches, other than its own arguments. Translated code leaves before an op which would touch I/O.
+enum {
+    kGBJITAccessNone        = 0,
+    kGBJITAccessReadHL      = 1,
+    kGBJITAccessWriteHL     = 2,
+    kGBJITAccessReadBC      = 3,
+    kGBJITAccessWriteBC     = 4,
+    kGBJITAccessReadDE      = 5,
+    kGBJITAccessWriteDE     = 6,
+    kGBJITAccessReadC       = 7, // 0xFF00 + c
+    kGBJITAccessWriteC      = 8,
+    kGBJITAccessStack       = 9, // sp - 2 --> sp + 1
+    kGBJITAccessReadIO      = 10, // 0xFF00 + argument
+    kGBJITAccessWriteIO     = 11,
+    kGBJITAccessRead16      = 12, // 16-bit argument
+    kGBJITAccessWrite16     = 13,
+    kGBJITAccessWrite16Pair = 14  // 16-bit argument and the byte after it
+};
+
+static void __GBJITClassify(uint8_t op, uint8_t *class, uint8_t *access)
+{
+    *class = kGBJITClassCall;
+    *access = kGBJITAccessNone;
+
+    if (op >= 0x40 && op < 0x80) {
+        if (op == 0x76) {
+            *class = kGBJITClassEnd;
+        } else if ((op & 0xF8) == 0x70) {
+            *access = kGBJITAccessWriteHL;
+        } else if ((op & 0x07) == 0x06) {
+            *access = kGBJITAccessReadHL;
+        } else {
+            *class = kGBJITClassInline;
+        }
+
+        return;
+    }
+
+    if (op >= 0x80 && op < 0xC0) {
+        if ((op & 0x07) == 0x06)
+            *access = kGBJITAccessReadHL;
+
+        return;
+    }
+
+    switch (op)
+    {
+        case 0x00:
+        case 0x01: case 0x11: case 0x21: case 0x31:
+        case 0x03: case 0x13: case 0x23: case 0x33:
+        case 0x0B: case 0x1B: case 0x2B: case 0x3B:
+        case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E:
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:
+            *class = kGBJITClassInline;
+        break;
+
+        case 0x02: *access = kGBJITAccessWriteBC; break;
+        case 0x0A: *access = kGBJITAccessReadBC;  break;
+        case 0x12: *access = kGBJITAccessWriteDE; break;
+        case 0x1A: *access = kGBJITAccessReadDE;  break;
+
+        case 0x22: case 0x32: case 0x34: case 0x35: case 0x36:
+            *access = kGBJITAccessWriteHL;
+        break;
+        case 0x2A: case 0x3A:
+            *access = kGBJITAccessReadHL;
+        break;
+
+        case 0x08: *access = kGBJITAccessWrite16Pair; break;
+        case 0xE0: *access = kGBJITAccessWriteIO; break;
+        case 0xF0: *access = kGBJITAccessReadIO;  break;
+        case 0xE2: *access = kGBJITAccessWriteC;  break;
+        case 0xF2: *access = kGBJITAccessReadC;   break;
+        case 0xEA: *access = kGBJITAccessWrite16; break;
+        case 0xFA: *access = kGBJITAccessRead16;  break;
+
+        case 0xC1: case 0xD1: case 0xE1: case 0xF1:
+        case 0xC5: case 0xD5: case 0xE5: case 0xF5:
+            *access = kGBJITAccessStack;
+        break;
+
+        case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8:
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            *class = kGBJITClassBranch;
+            *access = kGBJITAccessStack;
+        break;
+
+        case 0xE9:
+            *class = kGBJITClassBranch;
+        break;
+
+        // stop, reti, di, ei, and the undefined ops all change state the block doesn't know about
+        case 0x10: case 0xD9: case 0xF3: case 0xFB: case 0xCB:
+        case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4:
+        case 0xEB: case 0xEC: case 0xED: case 0xF4: case 0xFC: case 0xFD:
+            *class = kGBJITClassEnd;
+        break;
+
+        // Everything else only touches registers
+        default: break;
+    }
+}
+
+static uint8_t __GBJITLength(uint8_t op)
+{
+    // The prefix counts as a 1 byte op in the table, but the op after it always comes along
+    return (op == 0xCB) ? 2 : gGBInstructionLengths[op];
+}
+
+// Translated code may touch cartridge RAM, video RAM, work RAM, and high RAM directly. Writes to ROM go to the mapper.
+static bool __GBJITAddressIsPlain(uint32_t address, bool write)
+{
+    if (write && address < kGBCartROMBankHighEnd + 1)
+        return false;
+
+    if (address < 0xFE00)
+        return true;
+
+    return (address >= kGBHighRAMStart && address <= kGBHighRAMEnd);
+}
+
+#pragma mark - Emitter
+
+typedef struct {
+    uint8_t *start;
+    uint8_t *cursor;
+} GBJITEmitter;
+
+enum {
+    kGBJITConditionBelow        = 0x2,
+    kGBJITConditionAboveEqual   = 0x3,
+    kGBJITConditionZero         = 0x4,
+    kGBJITConditionNotZero      = 0x5,
+
+    kGBJITConditionAlways       = 0xFF
+};
+
+#define __GBJITStateOffset(field) ((uint32_t)offsetof(GBProcessor, state.field))
+
+// Register operands as they are encoded in ops (6 is (hl))
+static const uint32_t gGBJITRegisters[8] = {
+    __GBJITStateOffset(b), __GBJITStateOffset(c), __GBJITStateOffset(d), __GBJITStateOffset(e),
+    __GBJITStateOffset(h), __GBJITStateOffset(l), 0, __GBJITStateOffset(a)
+};
+
+static const uint32_t gGBJITRegisterPairs[4] = {
+    __GBJITStateOffset(bc), __GBJITStateOffset(de), __GBJITStateOffset(hl), __GBJITStateOffset(sp)
+};
+
+static void __GBJITEmit8(GBJITEmitter *e, uint8_t byte)
+{
+    *(e->cursor++) = byte;
+}
+
+static void __GBJITEmit16(GBJITEmitter *e, uint16_t value)
+{
+    memcpy(e->cursor, &value, sizeof(value));
+    e->cursor += sizeof(value);
+}
+
+static void __GBJITEmit32(GBJITEmitter *e, uint32_t value)
+{
+    memcpy(e->cursor, &value, sizeof(value));
+    e->cursor += sizeof(value);
+}
+
+static void __GBJITEmit64(GBJITEmitter *e, uint64_t value)
+{
+    memcpy(e->cursor, &value, sizeof(value));
+    e->cursor += sizeof(value);
+}
+
+// [rbx + offset] with the given /reg field
+static void __GBJITEmitState(GBJITEmitter *e, uint8_t reg, uint32_t offset)
+{
+    __GBJITEmit8(e, 0x80 | (reg << 3) | 0x3);
+    __GBJITEmit32(e, offset);
+}
+
+// mov byte [rbx + offset], imm8
+static void __GBJITEmitStore8(GBJITEmitter *e, uint32_t offset, uint8_t value)
+{
+    __GBJITEmit8(e, 0xC6);
+    __GBJITEmitState(e, 0, offset);
+    __GBJITEmit8(e, value);
+}
+
+// mov word [rbx + offset], imm16
+static void __GBJITEmitStore16(GBJITEmitter *e, uint32_t offset, uint16_t value)
+{
+    __GBJITEmit8(e, 0x66);
+    __GBJITEmit8(e, 0xC7);
+    __GBJITEmitState(e, 0, offset);
+    __GBJITEmit16(e, value);
+}
+
+// movzx eax, byte [rbx + offset]
+static void __GBJITEmitLoad8(GBJITEmitter *e, uint32_t offset)
+{
+    __GBJITEmit8(e, 0x0F);
+    __GBJITEmit8(e, 0xB6);
+    __GBJITEmitState(e, 0, offset);
+}
+
+// movzx eax, word [rbx + offset]
+static void __GBJITEmitLoad16(GBJITEmitter *e, uint32_t offset)
+{
+    __GBJITEmit8(e, 0x0F);
+    __GBJITEmit8(e, 0xB7);
+    __GBJITEmitState(e, 0, offset);
+}
+
+// mov byte [rbx + offset], al
+static void __GBJITEmitSave8(GBJITEmitter *e, uint32_t offset)
+{
+    __GBJITEmit8(e, 0x88);
+    __GBJITEmitState(e, 0, offset);
+}
+
+// add word [rbx + cycles], imm16
+static void __GBJITEmitCycles(GBJITEmitter *e, uint16_t cycles)
+{
+    __GBJITEmit8(e, 0x66);
+    __GBJITEmit8(e, 0x81);
+    __GBJITEmitState(e, 0, __GBJITStateOffset(cycles));
+    __GBJITEmit16(e, cycles);
+}
+
+// inc/dec word [rbx + offset]
+static void __GBJITEmitStep16(GBJITEmitter *e, uint32_t offset, bool increment)
+{
+    __GBJITEmit8(e, 0x66);
+    __GBJITEmit8(e, 0xFF);
+    __GBJITEmitState(e, increment ? 0 : 1, offset);
+}
+
+// test byte [rbx + offset], imm8
+static void __GBJITEmitTest8(GBJITEmitter *e, uint32_t offset, uint8_t mask)
+{
+    __GBJITEmit8(e, 0xF6);
+    __GBJITEmitState(e, 0, offset);
+    __GBJITEmit8(e, mask);
+}
+
+// cmp eax, imm32
+static void __GBJITEmitCompare(GBJITEmitter *e, uint32_t value)
+{
+    __GBJITEmit8(e, 0x3D);
+    __GBJITEmit32(e, value);
+}
+
+static void __GBJITEmitJump(GBJITEmitter *e, uint8_t condition, uint8_t *target)
+{
+    intptr_t distance = target - (e->cursor + 2);
+
+    if (distance >= INT8_MIN && distance <= INT8_MAX) {
+        __GBJITEmit8(e, (condition == kGBJITConditionAlways) ? 0xEB : (0x70 | condition));
+        __GBJITEmit8(e, (uint8_t)distance);
+    } else if (condition == kGBJITConditionAlways) {
+        __GBJITEmit8(e, 0xE9);
+        __GBJITEmit32(e, (uint32_t)(target - (e->cursor + 4)));
+    } else {
+        __GBJITEmit8(e, 0x0F);
+        __GBJITEmit8(e, 0x80 | condition);
+        __GBJITEmit32(e, (uint32_t)(target - (e->cursor + 4)));
+    }
+}
+
+// Short jump to somewhere we haven't emitted yet. Returns the byte to patch once we have.
+static uint8_t *__GBJITEmitForward(GBJITEmitter *e, uint8_t condition)
+{
+    __GBJITEmit8(e, (condition == kGBJITConditionAlways) ? 0xEB : (0x70 | condition));
+    __GBJITEmit8(e, 0);
+
+    return e->cursor - 1;
+}
+
+static void __GBJITPatch(uint8_t *patch, uint8_t *target)
+{
+    (*patch) = (uint8_t)(target - (patch + 1));
+}
+
+// Work out f if the last op left it pending (see kGBProcessorLazyFlags)
+static void __GBJITEmitResolveFlags(GBJITEmitter *e)
+{
+    // cmp byte [rbx + lazy.op], 0
+    __GBJITEmit8(e, 0x80);
+    __GBJITEmitState(e, 7, __GBJITStateOffset(lazy.op));
+    __GBJITEmit8(e, 0);
+
+    uint8_t *skip = __GBJITEmitForward(e, kGBJITConditionZero);
+
+    // mov rdi, rbx; mov rax, __ALUResolveFlags; call rax
+    __GBJITEmit8(e, 0x48); __GBJITEmit8(e, 0x89); __GBJITEmit8(e, 0xDF);
+    __GBJITEmit8(e, 0x48); __GBJITEmit8(e, 0xB8);
+    __GBJITEmit64(e, (uint64_t)(uintptr_t)__ALUResolveFlags);
+    __GBJITEmit8(e, 0xFF); __GBJITEmit8(e, 0xD0);
+
+    __GBJITPatch(skip, e->cursor);
+}
+
+// Leave the block at `exit` unless eax holds an address translated code may touch.
+static void __GBJITEmitCheck(GBJITEmitter *e, bool write, uint8_t *exit)
+{
+    if (write)
+    {
+        __GBJITEmitCompare(e, kGBCartROMBankHighEnd + 1);
+        __GBJITEmitJump(e, kGBJITConditionBelow, exit);
+    }
+
+    __GBJITEmitCompare(e, 0xFE00);
+    uint8_t *plain = __GBJITEmitForward(e, kGBJITConditionBelow);
+
+    __GBJITEmitCompare(e, kGBHighRAMStart);
+    __GBJITEmitJump(e, kGBJITConditionBelow, exit);
+    __GBJITEmitCompare(e, kGBHighRAMEnd + 1);
+    __GBJITEmitJump(e, kGBJITConditionAboveEqual, exit);
+
+    __GBJITPatch(plain, e->cursor);
+}
+
+// Leave the block, resuming the interpreter at `pc`
+static void __GBJITEmitExit(GBJITEmitter *e, uint16_t pc, uint8_t *epilogue)
+{
+    __GBJITEmitStore16(e, __GBJITStateOffset(pc), pc);
+
+    // mov eax, r13d
+    __GBJITEmit8(e, 0x44); __GBJITEmit8(e, 0x89); __GBJITEmit8(e, 0xE8);
+
+    __GBJITEmitJump(e, kGBJITConditionAlways, epilogue);
+}
+
+#pragma mark - Translation
+
+typedef struct {
+    GBJITEmitter emitter;
+
+    uint8_t *epilogue;
+
+    uint16_t pcs[kGBJITMaxInstructions];
+    uint8_t *headers[kGBJITMaxInstructions];
+    uint8_t count;
+} GBJITBlockBuilder;
+
+static uint8_t __GBJITReadROM(GBCartROM *rom, uint16_t bank, uint16_t address)
+{
+    return rom->romData[(bank * (kGBMemoryBankSize * 4)) + (address & kGBCartROMBankLowEnd)];
+}
+
+// Continue at `target`. Loops back into the block go straight to the instruction (which checks the budget first).
+static void __GBJITEmitGoto(GBJITBlockBuilder *builder, uint16_t target)
+{
+    for (uint8_t i = 0; i < builder->count; i++)
+    {
+        if (builder->pcs[i] == target)
+        {
+            __GBJITEmitJump(&builder->emitter, kGBJITConditionAlways, builder->headers[i]);
+
+            return;
+        }
+    }
+
+    __GBJITEmitExit(&builder->emitter, target, builder->epilogue);
+}
+
+// jr/jp, both conditional and not. Returns true if the block ends here.
+static bool __GBJITEmitBranch(GBJITBlockBuilder *builder, uint8_t op, uint16_t target, uint16_t notTaken, uint16_t taken)
+{
+    GBJITEmitter *e = &builder->emitter;
+
+    if (op == 0x18 || op == 0xC3)
+    {
+        __GBJITEmitCycles(e, taken);
+        __GBJITEmitGoto(builder, target);
+
+        return true;
+    }
+
+    // nz, z, nc, c
+    uint8_t condition = (op >> 3) & 0x3;
+    uint8_t mask = (condition < 2) ? 0x80 : 0x10;
+
+    __GBJITEmitCycles(e, notTaken);
+    __GBJITEmitResolveFlags(e);
+    __GBJITEmitTest8(e, __GBJITStateOffset(f.reg), mask);
+
+    uint8_t *skip = __GBJITEmitForward(e, (condition & 1) ? kGBJITConditionZero : kGBJITConditionNotZero);
+
+    __GBJITEmitCycles(e, taken - notTaken);
+    __GBJITEmitGoto(builder, target);
+
+    __GBJITPatch(skip, e->cursor);
+
+    return false;
+}
+
+static void __GBJITEmitAccessCheck(GBJITEmitter *e, uint8_t access, uint8_t *exit)
+{
+    switch (access)
+    {
+        case kGBJITAccessReadHL:
+        case kGBJITAccessWriteHL:
+            __GBJITEmitLoad16(e, __GBJITStateOffset(hl));
+            __GBJITEmitCheck(e, access == kGBJITAccessWriteHL, exit);
+        break;
+        case kGBJITAccessReadBC:
+        case kGBJITAccessWriteBC:
+            __GBJITEmitLoad16(e, __GBJITStateOffset(bc));
+            __GBJITEmitCheck(e, access == kGBJITAccessWriteBC, exit);
+        break;
+        case kGBJITAccessReadDE:
+        case kGBJITAccessWriteDE:
+            __GBJITEmitLoad16(e, __GBJITStateOffset(de));
+            __GBJITEmitCheck(e, access == kGBJITAccessWriteDE, exit);
+        break;
+        case kGBJITAccessReadC:
+        case kGBJITAccessWriteC:
+            __GBJITEmitLoad8(e, __GBJITStateOffset(c));
+
+            // add eax, 0xFF00
+            __GBJITEmit8(e, 0x05);
+            __GBJITEmit32(e, 0xFF00);
+
+            __GBJITEmitCheck(e, access == kGBJITAccessWriteC, exit);
+        break;
+        case kGBJITAccessStack:
+            // Both ends of sp - 2 --> sp + 1. I/O is too big to fit between them.
+            __GBJITEmitLoad16(e, __GBJITStateOffset(sp));
+
+            // sub eax, 2
+            __GBJITEmit8(e, 0x83); __GBJITEmit8(e, 0xE8); __GBJITEmit8(e, 0x02);
+            __GBJITEmitCheck(e, true, exit);
+
+            __GBJITEmitLoad16(e, __GBJITStateOffset(sp));
+
+            // add eax, 1
+            __GBJITEmit8(e, 0x83); __GBJITEmit8(e, 0xC0); __GBJITEmit8(e, 0x01);
+            __GBJITEmitCheck(e, true, exit);
+        break;
+        default: break;
+    }
+}
+
+// Check accesses whose address is in the instruction itself. These are decided while translating.
+static bool __GBJITAccessAllowed(uint8_t access, uint8_t lo, uint8_t hi)
+{
+    uint16_t address = lo | (hi << 8);
+
+    switch (access)
+    {
+        case kGBJITAccessReadIO:     return __GBJITAddressIsPlain(0xFF00 + lo, false);
+        case kGBJITAccessWriteIO:    return __GBJITAddressIsPlain(0xFF00 + lo, true);
+        case kGBJITAccessRead16:     return __GBJITAddressIsPlain(address, false);
+        case kGBJITAccessWrite16:    return __GBJITAddressIsPlain(address, true);
+        case kGBJITAccessWrite16Pair:
+            return __GBJITAddressIsPlain(address, true) && __GBJITAddressIsPlain(address + 1, true);
+        default:
+            return true;
+    }
+}
+
+static GBJITBlockCode __GBJITTranslate(GBProcessorJIT *this, uint16_t bank, uint16_t start)
+{
+    GBJITBlockBuilder builder;
+    GBJITEmitter *e = &builder.emitter;
+    GBCartROM *rom = this->rom;
+
+    uint16_t limit = (start <= kGBCartROMBankLowEnd) ? kGBCartROMBankLowEnd : kGBCartROMBankHighEnd;
+    uint16_t pc = start;
+    bool done = false;
+
+    e->start = this->code + this->codeUsed;
+    e->cursor = e->start;
+    builder.count = 0;
+
+    // Epilogue: pop r13; pop r12; pop rbx; ret
+    builder.epilogue = e->cursor;
+    __GBJITEmit8(e, 0x41); __GBJITEmit8(e, 0x5D);
+    __GBJITEmit8(e, 0x41); __GBJITEmit8(e, 0x5C);
+    __GBJITEmit8(e, 0x5B);
+    __GBJITEmit8(e, 0xC3);
+
+    // Entry: push rbx; push r12; push r13; mov rbx, rdi; mov r12d, esi; xor r13d, r13d
+    GBJITBlockCode code = (GBJITBlockCode)e->cursor;
+    __GBJITEmit8(e, 0x53);
+    __GBJITEmit8(e, 0x41); __GBJITEmit8(e, 0x54);
+    __GBJITEmit8(e, 0x41); __GBJITEmit8(e, 0x55);
+    __GBJITEmit8(e, 0x48); __GBJITEmit8(e, 0x89); __GBJITEmit8(e, 0xFB);
+    __GBJITEmit8(e, 0x41); __GBJITEmit8(e, 0x89); __GBJITEmit8(e, 0xF4);
+    __GBJITEmit8(e, 0x45); __GBJITEmit8(e, 0x31); __GBJITEmit8(e, 0xED);
+
+    // The first instruction doesn't check the budget. The processor is due to run it now.
+    __GBJITEmit8(e, 0xE9);
+    __GBJITEmit32(e, 0);
+    uint8_t *entry = e->cursor - 4;
+
+    while (!done && builder.count < kGBJITMaxInstructions)
+    {
+        // A long enough block doesn't fit in what's left. End it early instead of writing past the buffer.
+        if (e->cursor + kGBJITInstructionSize > this->code + kGBJITCodeSize)
+            break;
+
+        uint8_t op = __GBJITReadROM(rom, bank, pc);
+        uint8_t length = __GBJITLength(op);
+        uint8_t class, access;
+
+        if (pc + length - 1 > limit)
+            break;
+
+        uint8_t lo = (length > 1) ? __GBJITReadROM(rom, bank, pc + 1) : 0;
+        uint8_t hi = (length > 2) ? __GBJITReadROM(rom, bank, pc + 2) : 0;
+        GBJITOp call = NULL;
+
+        if (op == 0xCB) {
+            // Every prefixed op only touches registers or (hl)
+            class = kGBJITClassCall;
+            access = ((lo & 0x07) == 0x06) ? kGBJITAccessWriteHL : kGBJITAccessNone;
+            call = gGBJITOpsCB[lo];
+        } else {
+            __GBJITClassify(op, &class, &access);
+            call = gGBJITOps[op];
+        }
+
+        if (class == kGBJITClassEnd || !__GBJITAccessAllowed(access, lo, hi))
+            break;
+
+        // Header: leave if the budget is used up before this instruction starts.
+        // cmp eax, r12d; jb body
+        uint8_t *header = e->cursor;
+        __GBJITEmitLoad16(e, __GBJITStateOffset(cycles));
+        __GBJITEmit8(e, 0x44); __GBJITEmit8(e, 0x39); __GBJITEmit8(e, 0xE0);
+        uint8_t *body = __GBJITEmitForward(e, kGBJITConditionBelow);
+
+        uint8_t *exit = e->cursor;
+        __GBJITEmitExit(e, pc, builder.epilogue);
+        __GBJITPatch(body, e->cursor);
+
+        if (!builder.count)
+        {
+            uint32_t distance = (uint32_t)(e->cursor - (entry + 4));
+
+            memcpy(entry, &distance, sizeof(distance));
+        }
+
+        builder.pcs[builder.count] = pc;
+        builder.headers[builder.count] = header;
+        builder.count++;
+
+        __GBJITEmitAccessCheck(e, access, exit);
+
+        // inc r13d
+        __GBJITEmit8(e, 0x41); __GBJITEmit8(e, 0xFF); __GBJITEmit8(e, 0xC5);
+
+        uint16_t next = pc + length;
+
+        if (class == kGBJITClassInline) {
+            if (op == 0x00) {
+                __GBJITEmitCycles(e, 4);
+            } else if (op >= 0x40 && op < 0x80) {
+                // ld r, r
+                __GBJITEmitLoad8(e, gGBJITRegisters[op & 0x7]);
+                __GBJITEmitSave8(e, gGBJITRegisters[(op >> 3) & 0x7]);
+                __GBJITEmitCycles(e, 4);
+            } else if ((op & 0xC7) == 0x06) {
+                // ld r, d8
+                __GBJITEmitStore8(e, gGBJITRegisters[(op >> 3) & 0x7], lo);
+                __GBJITEmitCycles(e, 8);
+            } else if ((op & 0xCF) == 0x01) {
+                // ld rr, d16
+                __GBJITEmitStore16(e, gGBJITRegisterPairs[op >> 4], lo | (hi << 8));
+                __GBJITEmitCycles(e, 12);
+            } else if ((op & 0xC7) == 0x03) {
+                // inc rr, dec rr (they stall once)
+                __GBJITEmitStep16(e, gGBJITRegisterPairs[op >> 4], !(op & 0x08));
+                __GBJITEmitCycles(e, 8);
+            } else if (op < 0x40) {
+                // jr (argument, then stall if taken)
+                done = __GBJITEmitBranch(&builder, op, next + (int8_t)lo, 8, 12);
+            } else {
+                // jp (two arguments, then stall if taken)
+                done = __GBJITEmitBranch(&builder, op, lo | (hi << 8), 12, 16);
+            }
+        } else {
+            // The op reads its own arguments from pc, just like the interpreter
+            __GBJITEmitCycles(e, (op == 0xCB) ? 2 * kGBProcessorAccessCycles : kGBProcessorAccessCycles);
+            __GBJITEmitStore16(e, __GBJITStateOffset(pc), pc + ((op == 0xCB) ? 2 : 1));
+
+            // mov rdi, rbx; mov rax, call; call rax
+            __GBJITEmit8(e, 0x48); __GBJITEmit8(e, 0x89); __GBJITEmit8(e, 0xDF);
+            __GBJITEmit8(e, 0x48); __GBJITEmit8(e, 0xB8);
+            __GBJITEmit64(e, (uint64_t)(uintptr_t)call);
+            __GBJITEmit8(e, 0xFF); __GBJITEmit8(e, 0xD0);
+
+            if (class == kGBJITClassBranch)
+            {
+                // mov eax, r13d; jmp epilogue (the op already set pc)
+                __GBJITEmit8(e, 0x44); __GBJITEmit8(e, 0x89); __GBJITEmit8(e, 0xE8);
+                __GBJITEmitJump(e, kGBJITConditionAlways, builder.epilogue);
+
+                done = true;
+            }
+        }
+
+        pc = next;
+    }
+
+    if (!builder.count)
+        return NULL;
+
+    if (!done)
+        __GBJITEmitExit(e, pc, builder.epilogue);
+
+    this->codeUsed += e->cursor - e->start;
+    this->compiled++;
+
+    return code;
+}
+
+#pragma mark - Block Cache
+
+static GBJITBlock *__GBJITLookup(GBProcessorJIT *this, uint16_t bank, uint16_t pc)
+{
+    uint32_t key = (bank << 16) | pc;
+    uint32_t bucket = (key ^ (key >> 11)) & (kGBJITBucketCount - 1);
+
+    for (GBJITBlock *block = this->buckets[bucket]; block; block = block->next)
+    {
+        if (block->key == key)
+            return block;
+    }
+
+    if (this->blockCount == kGBJITBlockCount || this->codeUsed + kGBJITBlockSize > kGBJITCodeSize)
+        GBProcessorJITFlush(this);
+
+    GBJITBlock *block = &this->blocks[this->blockCount++];
+
+    block->key = key;
+    block->code = __GBJITTranslate(this, bank, pc);
+    block->next = this->buckets[bucket];
+    this->buckets[bucket] = block;
+
+    return block;
+}
+
+#pragma mark - Verification
+
+// Run a block, undo it, then run the same instructions through the interpreter and compare.
+// The interpreter's results are the ones we keep.
+static uint32_t __GBJITRunVerified(GBProcessorJIT *this, GBProcessor *cpu, GBJITBlock *block, uint32_t budget)
+{
+    GBMemoryManager *mmu = cpu->mmu;
+    GBProcessorState before = cpu->state;
+
+    if (budget > kGBJITVerifyBudget)
+        budget = kGBJITVerifyBudget;
+
+    // Writes have to come through __GBJITAccess to be logged
+    bool synchronous = mmu->synchronous;
+
+    mmu->synchronous = false;
+    this->undoCount = 0;
+
+    uint32_t count = block->code(cpu, budget);
+    mmu->synchronous = synchronous;
+
+    if (!count)
+        return 0;
+
+    // Pending flags are compared once they're worked out
+    __ALUResolveFlags(cpu);
+
+    GBProcessorState after = cpu->state;
+    uint8_t written[kGBJITUndoLogSize];
+
+    for (uint16_t i = 0; i < this->undoCount; i++)
+        written[i] = __GBMemoryManagerRead(mmu, this->undo[i].address);
+
+    for (uint16_t i = this->undoCount; i > 0; i--)
+        __GBMemoryManagerWrite(mmu, this->undo[i - 1].address, this->undo[i - 1].value);
+
+    cpu->state = before;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        __GBProcessorFastDecode(cpu);
+
+        while (cpu->state.mode > kGBProcessorModeFetch)
+        {
+            GBDispatchOP(cpu);
+            __GBProcessorFastAccess(cpu);
+        }
+    }
+
+    __ALUResolveFlags(cpu);
+
+    bool matches = (after.a == cpu->state.a && after.f.reg == cpu->state.f.reg &&
+                    after.bc == cpu->state.bc && after.de == cpu->state.de && after.hl == cpu->state.hl &&
+                    after.sp == cpu->state.sp && after.pc == cpu->state.pc && after.cycles == cpu->state.cycles);
+
+    for (uint16_t i = 0; i < this->undoCount; i++)
+        matches &= (written[i] == __GBMemoryManagerRead(mmu, this->undo[i].address));
+
+    if (!matches)
+    {
+        fprintf(stderr, "Warning: Translated block at %03X:%04X doesn't match the interpreter after %u instructions.\n", block->key >> 16, block->key & 0xFFFF, count);
+        fprintf(stderr, "Note: JIT:         pc=0x%04X sp=0x%04X af=0x%02X%02X bc=0x%04X de=0x%04X hl=0x%04X cycles=%u\n", after.pc, after.sp, after.a, after.f.reg, after.bc, after.de, after.hl, after.cycles);
+        fprintf(stderr, "Note: Interpreter: pc=0x%04X sp=0x%04X af=0x%02X%02X bc=0x%04X de=0x%04X hl=0x%04X cycles=%u\n", cpu->state.pc, cpu->state.sp, cpu->state.a, cpu->state.f.reg, cpu->state.bc, cpu->state.de, cpu->state.hl, cpu->state.cycles);
+
+        this->mismatches++;
+    }
+
+    return count;
+}
+
+#pragma mark - JIT
+
+GBProcessorJIT *GBProcessorJITCreate(void)
+{
+    GBProcessorJIT *jit = malloc(sizeof(GBProcessorJIT));
+
+    if (jit)
+    {
+        jit->blocks = malloc(kGBJITBlockCount * sizeof(GBJITBlock));
+
+        if (!jit->blocks)
+        {
+            free(jit);
+
+            return NULL;
+        }
+
+        int flags = MAP_PRIVATE | MAP_ANON;
+
+        #ifdef MAP_JIT
+            flags |= MAP_JIT;
+        #endif /* defined(MAP_JIT) */
+
+        jit->code = mmap(NULL, kGBJITCodeSize, PROT_READ | PROT_WRITE | PROT_EXEC, flags, -1, 0);
+
+        if (jit->code == MAP_FAILED)
+        {
+            fprintf(stderr, "Error: Couldn't map memory for translated code!\n");
+
+            free(jit->blocks);
+            free(jit);
+
+            return NULL;
+        }
+
+        jit->rom = NULL;
+        jit->enabled = false;
+        jit->verify = false;
+
+        jit->undoCount = 0;
+
+        jit->compiled = 0;
+        jit->entered = 0;
+        jit->instructions = 0;
+        jit->fallbacks = 0;
+        jit->mismatches = 0;
+
+        GBProcessorJITFlush(jit);
+    }
+
+    return jit;
+}
+
+void GBProcessorJITDestroy(GBProcessorJIT *this)
+{
+    munmap(this->code, kGBJITCodeSize);
+
+    free(this->blocks);
+    free(this);
+}
+
+void GBProcessorJITFlush(GBProcessorJIT *this)
+{
+    this->codeUsed = 0;
+    this->blockCount = 0;
+
+    for (uint32_t i = 0; i < kGBJITBucketCount; i++)
+        this->buckets[i] = NULL;
+}
+
+bool GBProcessorJITRun(GBProcessorJIT *this, GBProcessor *cpu)
+{
+    GBMemoryManager *mmu = cpu->mmu;
+    uint16_t pc = cpu->state.pc;
+
+    // Only cartridge ROM is translated, and nothing runs while DMA has the bus.
+    if (!this->rom || pc > kGBCartROMBankHighEnd || (pc < 0x100 && !(*mmu->romMasked)) || *mmu->dma)
+    {
+        this->fallbacks++;
+
+        return false;
+    }
+
+    uint16_t bank = (pc <= kGBCartROMBankLowEnd) ? this->rom->lowBank : this->rom->bank;
+    GBJITBlock *block = __GBJITLookup(this, bank, pc);
+
+    uint32_t budget = cpu->budget;
+    uint32_t count = 0;
+
+    if (budget > kGBJITMaxBudget)
+        budget = kGBJITMaxBudget;
+
+    if (block->code)
+        count = this->verify ? __GBJITRunVerified(this, cpu, block, budget) : block->code(cpu, budget);
+
+    if (!count)
+    {
+        this->fallbacks++;
+
+        return false;
+    }
+
+    this->entered++;
+    this->instructions += count;
+
+    return true;
+}
+
+#else /* !kGBJITAvailable */
+
+GBProcessorJIT *GBProcessorJITCreate(void)
+{
+    return NULL;
+}
+
+void GBProcessorJITDestroy(GBProcessorJIT *this)
+{
+    free(this);
+}
+
+void GBProcessorJITFlush(GBProcessorJIT *this)
+{
+    //
+}
+
+bool GBProcessorJITRun(GBProcessorJIT *this, GBProcessor *cpu)
+{
+    return false;
+}
+
+#endif /* kGBJITAvailable */
@@ -8,12 +8,13 @@
 void __GBGraphicsDriverVBlankReset(GBGraphicsDriver *this);
 void __GBGraphicsDriverSetMode(GBGraphicsDriver *this, uint8_t mode);
 void __GBGraphicsDriverCheckCoincidence(GBGraphicsDriver *this);
+void __GBGraphicsDriverEndLine(GBGraphicsDriver *this);
 
 #pragma mark - Video RAM
 
 GBVideoRAM *GBVideoRAMCreate(void)
 {
-    GBVideoRAM *ram = malloc(sizeof(GBVideoRAM));
+    GBVideoRAM *ram = GBAllocate(sizeof(GBVideoRAM));
 
     if (ram)
     {
@@ -31,6 +32,8 @@ GBVideoRAM *GBVideoRAMCreate(void)
         #else /* !defined(__APPLE__) */
             bzero(ram->memory, kGBVideoRAMSize);
         #endif /* defined(__APPLE__) */
+
+        GBVideoRAMInvalidateTiles(ram);
     }
 
     return ram;
@@ -38,7 +41,7 @@ GBVideoRAM *GBVideoRAMCreate(void)
 
 void GBVideoRAMDestroy(GBVideoRAM *this)
 {
-    free(this);
+    GBRelease(this);
 }
 
 void __GBVideoRAMWrite(GBVideoRAM *this, uint16_t address, uint8_t byte)
@@ -58,7 +61,16 @@ void __GBVideoRAMWrite(GBVideoRAM *this, uint16_t address, uint8_t byte)
         //fprintf(stderr, "note: wrote to background map 1. (0x%04X=0x%02X)\n", address, byte);
     }
 
-    this->memory[address & (~0x8000)] = byte;
+    uint16_t offset = address & (~0x8000);
+
+    if (offset < (kGBVideoRAMTileCount * kGBVideoRAMTileBytes) && this->memory[offset] != byte)
+    {
+        uint16_t tile = offset / kGBVideoRAMTileBytes;
+
+        this->dirtyTiles[tile >> 5] |= (1U << (tile & 0x1F));
+    }
+
+    this->memory[offset] = byte;
 }
 
 uint8_t __GBVideoRAMRead(GBVideoRAM *this, uint16_t address)
@@ -77,11 +89,61 @@ bool __GBVideoRAMOnInstall(GBVideoRAM *this, GBGameboy *gameboy)
     return GBMemoryManagerInstallSpace(gameboy->cpu->mmu, (GBMemorySpace *)this);
 }
 
+const uint8_t *GBVideoRAMTile(GBVideoRAM *this, uint16_t index)
+{
+    uint32_t bit = 1U << (index & 0x1F);
+
+    if (this->dirtyTiles[index >> 5] & bit)
+    {
+        GBTileDecodeRows(&this->memory[index * kGBVideoRAMTileBytes], 8, this->tiles[index]);
+
+        this->dirtyTiles[index >> 5] &= ~bit;
+    }
+
+    return this->tiles[index];
+}
+
+void GBVideoRAMUpdateTiles(GBVideoRAM *this)
+{
+    uint16_t index = 0;
+
+    while (index < kGBVideoRAMTileCount)
+    {
+        if (!(index & 0x1F) && !this->dirtyTiles[index >> 5])
+        {
+            index += 32;
+            continue;
+        }
+
+        if (!(this->dirtyTiles[index >> 5] & (1U << (index & 0x1F))))
+        {
+            index++;
+            continue;
+        }
+
+        // Changed tiles next to each other are decoded together
+        uint16_t start = index;
+
+        while (index < kGBVideoRAMTileCount && (this->dirtyTiles[index >> 5] & (1U << (index & 0x1F))))
+        {
+            this->dirtyTiles[index >> 5] &= ~(1U << (index & 0x1F));
+            index++;
+        }
+
+        GBTileDecodeRows(&this->memory[start * kGBVideoRAMTileBytes], (index - start) * 8, this->tiles[start]);
+    }
+}
+
+void GBVideoRAMInvalidateTiles(GBVideoRAM *this)
+{
+    memset(this->dirtyTiles, 0xFF, sizeof(this->dirtyTiles));
+}
+
 #pragma mark - Sprite RAM
 
 GBSpriteRAM *GBSpriteRAMCreate(void)
 {
-    GBSpriteRAM *ram = malloc(sizeof(GBSpriteRAM));
+    GBSpriteRAM *ram = GBAllocate(sizeof(GBSpriteRAM));
 
     if (ram)
     {
@@ -106,7 +168,7 @@ GBSpriteRAM *GBSpriteRAMCreate(void)
 
 void GBSpriteRAMDestroy(GBSpriteRAM *this)
 {
-    free(this);
+    GBRelease(this);
 }
 
 void __GBSpriteRAMWrite(GBSpriteRAM *this, uint16_t address, uint8_t byte)
@@ -146,7 +208,7 @@ bool __GBSpriteRAMOnInstall(GBSpriteRAM *this, GBGameboy *gameboy)
 
 GBLCDControlPort *GBLCDControlPortCreate(GBCoordPort *coordPort)
 {
-    GBLCDControlPort *port = malloc(sizeof(GBLCDControlPort));
+    GBLCDControlPort *port = GBAllocate(sizeof(GBLCDControlPort));
 
     if (port)
     {
@@ -184,17 +246,22 @@ void __GBLCDControlPortWrite(GBLCDControlPort *this, uint8_t byte)
         fprintf(stderr, "Note: Turned off display.\n");
 
         memset(this->driver->screenData, this->driver->nullColor, kGBScreenWidth * kGBScreenHeight * sizeof(uint32_t));
+        memset(this->driver->screenIndices, kGBShadeBlack, kGBScreenWidth * kGBScreenHeight);
+        GBGraphicsDriverDamageAll(this->driver);
 
         __GBGraphicsDriverVBlankReset(this->driver);
     } else if ((byte >> 7) && wasOff) {
         this->driver->driverMode = kGBDriverStateSpriteSearch;
         this->driver->driverModeTicks = 0;
+        this->driver->lastTick = kGBClockNever;
         this->driver->displayOn = true;
 
         fprintf(stderr, "Note: Turned on display.\n");
 
         // TODO: Set display to lookup index 0
         memset(this->driver->screenData, 0x00, kGBScreenWidth * kGBScreenHeight * sizeof(uint32_t));
+        memset(this->driver->screenIndices, kGBShadeBlack, kGBScreenWidth * kGBScreenHeight);
+        GBGraphicsDriverDamageAll(this->driver);
 
         __GBGraphicsDriverVBlankReset(this->driver);
     }
@@ -202,7 +269,7 @@ void __GBLCDControlPortWrite(GBLCDControlPort *this, uint8_t byte)
 
 GBLCDStatusPort *GBLCDStatusPortCreate(void)
 {
-    GBLCDStatusPort *port = malloc(sizeof(GBLCDStatusPort));
+    GBLCDStatusPort *port = GBAllocate(sizeof(GBLCDStatusPort));
 
     if (port)
     {
@@ -227,7 +294,7 @@ void __GBLCDStatusPortWrite(GBLCDStatusPort *this, uint8_t byte)
 
 GBCoordPort *GBCoordPortCreate(void)
 {
-    GBCoordPort *port = malloc(sizeof(GBCoordPort));
+    GBCoordPort *port = GBAllocate(sizeof(GBCoordPort));
 
     if (port)
     {
@@ -247,35 +314,166 @@ void __GBCoordPortWrite(GBCoordPort *this, uint8_t byte)
     this->value = 0;
 }
 
-void __GBVideoPortGenericDebugWrite(GBVideoPortGeneric *reg, uint8_t byte)
+#pragma mark - Scanline Renderer
+
+// The tile a background or window map entry points to
+static uint16_t __GBGraphicsDriverMapTile(GBGraphicsDriver *this, uint8_t tile)
 {
-    printf("Port 0x%04X: 0x%04X --> 0x%04X\n", reg->address, reg->value, byte);
+    // Either 0x8000 --> 0x8FFF or 0x8800 --> 0x97FF (where tile 0 is at 0x9000)
+    if (this->control->value & 0x10)
+        return tile;
 
-    __GBIORegisterSimpleWrite((GBIORegister *)reg, byte);
+    return 0x80 + (uint8_t)(tile + 0x80);
 }
 
-GBVideoPortGeneric *GBVideoPortGenericCreate(uint16_t address)
+// Copy `count` decoded tiles from a row of a map, starting at column `column` (wraps over x)
+static void __GBGraphicsDriverDecodeMapRow(GBGraphicsDriver *this, uint16_t map, uint8_t row, uint8_t column, uint8_t count, uint8_t *pixels)
 {
-    GBVideoPortGeneric *port = malloc(sizeof(GBVideoPortGeneric));
+    uint16_t line = map + ((row / kGBTileHeight) * kGBMapWidth);
+    uint8_t tileRow = kGBTileWidth * (row % kGBTileHeight);
 
-    if (port)
+    for (uint8_t i = 0; i < count; i++)
     {
-        port->address = address;
+        uint16_t tile = __GBGraphicsDriverMapTile(this, this->vram->memory[line + ((column + i) % kGBMapWidth)]);
 
-        port->write = (void *)__GBIORegisterSimpleWrite;
-        port->read = (void *)__GBIORegisterSimpleRead;
+        memcpy(pixels + (i * kGBTileWidth), GBVideoRAMTile(this->vram, tile) + tileRow, kGBTileWidth);
+    }
+}
 
-        port->value = 0x00;
+// Sprites on this line in the order they win over each other (lowest x first, then OAM order). At most 10.
+static uint8_t __GBGraphicsDriverLineSprites(GBGraphicsDriver *this, uint8_t line, uint8_t height, GBSpriteDescriptor **sprites)
+{
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < 40 && count < 10; i++)
+    {
+        GBSpriteDescriptor *sprite = &this->oam->memory[i];
+        uint8_t row = (line + 16) - sprite->y;
+
+        if (row >= height)
+            continue;
+
+        uint8_t position = count++;
+
+        while (position && sprites[position - 1]->x > sprite->x)
+        {
+            sprites[position] = sprites[position - 1];
+            position--;
+        }
+
+        sprites[position] = sprite;
     }
 
-    return port;
+    return count;
+}
+
+static void __GBGraphicsDriverRenderLine(GBGraphicsDriver *this)
+{
+    uint8_t control = this->control->value;
+    uint8_t line = this->coordinate->value;
+
+    // Decoded tiles, color indices before the palette is applied (sprite priority looks at these) and the final shades
+    uint8_t tiles[kGBScreenWidth + (2 * kGBTileWidth)];
+    uint8_t background[kGBScreenWidth];
+    uint8_t shades[kGBScreenWidth];
+
+    if (control & 0x01) {
+        uint8_t scrollX = *this->scrollX;
+        uint8_t row = line + *this->scrollY;
+
+        __GBGraphicsDriverDecodeMapRow(this, (control & 0x08) ? 0x1C00 : 0x1800, row, scrollX / kGBTileWidth, (kGBScreenWidth / kGBTileWidth) + 1, tiles);
+        memcpy(background, tiles + (scrollX % kGBTileWidth), kGBScreenWidth);
+
+        // The window covers everything right of its x position (which is offset by 7)
+        int16_t windowStart = *this->windowX - 7;
+
+        if ((control & 0x20) && line >= *this->windowY && windowStart < kGBScreenWidth)
+        {
+            uint8_t skip = (windowStart < 0) ? -windowStart : 0;
+            uint8_t start = (windowStart < 0) ? 0 : windowStart;
+
+            __GBGraphicsDriverDecodeMapRow(this, (control & 0x40) ? 0x1C00 : 0x1800, this->windowLine++, 0, (kGBScreenWidth / kGBTileWidth) + 1, tiles);
+            memcpy(background + start, tiles + skip, kGBScreenWidth - start);
+        }
+    } else {
+        // Background and window are both blank (color 0) when they're turned off
+        memset(background, 0, kGBScreenWidth);
+    }
+
+    for (uint8_t x = 0; x < kGBScreenWidth; x++)
+        shades[x] = (*this->paletteBG >> (2 * background[x])) & 0x3;
+
+    if (control & 0x02)
+    {
+        GBSpriteDescriptor *sprites[10];
+        uint8_t height = (control & 0x04) ? 16 : 8;
+        uint8_t count = __GBGraphicsDriverLineSprites(this, line, height, sprites);
+
+        // A pixel belongs to the first sprite with a color there, even if that sprite is behind the background
+        bool taken[kGBScreenWidth];
+        memset(taken, 0, kGBScreenWidth);
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            GBSpriteDescriptor *sprite = sprites[i];
+            uint8_t palette = (sprite->attributes & 0x10) ? *this->paletteSprite1 : *this->paletteSprite0;
+            uint8_t row = (line + 16) - sprite->y;
+            uint8_t pattern = sprite->pattern;
+
+            if (sprite->attributes & 0x40)
+                row = (height - 1) - row;
+
+            if (height == 16)
+                pattern &= 0xFE;
+
+            // 8x16 sprites run into the next tile
+            const uint8_t *pixels = GBVideoRAMTile(this->vram, pattern + (row / kGBTileHeight)) + (kGBTileWidth * (row % kGBTileHeight));
+
+            for (uint8_t column = 0; column < kGBTileWidth; column++)
+            {
+                uint8_t color = pixels[(sprite->attributes & 0x20) ? (7 - column) : column];
+                uint8_t x = (sprite->x - 8) + column;
+
+                if (!color || x >= kGBScreenWidth || taken[x])
+                    continue;
+
+                taken[x] = true;
+
+                if ((sprite->attributes & 0x80) && background[x])
+                    continue;
+
+                shades[x] = (palette >> (2 * color)) & 0x3;
+            }
+        }
+    }
+
+    if (this->indexed)
+    {
+        uint8_t *indices = &this->screenIndices[this->linePointer - this->screenData];
+
+        for (uint8_t x = 0; x < kGBScreenWidth; x++)
+        {
+            this->lineChanges |= indices[x] ^ shades[x];
+            indices[x] = shades[x];
+        }
+
+        return;
+    }
+
+    for (uint8_t x = 0; x < kGBScreenWidth; x++)
+    {
+        uint32_t color = this->colorLookup[shades[x]];
+
+        this->lineChanges |= this->linePointer[x] ^ color;
+        this->linePointer[x] = color;
+    }
 }
 
 #pragma mark - LCD Driver
 
 GBGraphicsDriver *GBGraphicsDriverCreate(void)
 {
-    GBGraphicsDriver *driver = malloc(sizeof(GBGraphicsDriver));
+    GBGraphicsDriver *driver = GBAllocate(sizeof(GBGraphicsDriver));
 
     if (driver)
     {
@@ -283,33 +481,15 @@ GBGraphicsDriver *GBGraphicsDriverCreate(void)
 
         if (!driver->oam)
         {
-            free(driver);
+            GBRelease(driver);
 
             return NULL;
         }
 
         bool success = true;
 
-        driver->paletteSprite1 = GBVideoPortGenericCreate(kGBPalettePortSprite1Address);
-        driver->paletteSprite0 = GBVideoPortGenericCreate(kGBPalettePortSprite0Address);
-        driver->paletteBG = GBVideoPortGenericCreate(kGBPalettePortBGAddress);
-
-        success &= !!driver->paletteBG & !!driver->paletteSprite0 && !!driver->paletteSprite1;
-
-        driver->windowX = GBVideoPortGenericCreate(kGBLineWindowPortXAddress);
-        driver->windowY = GBVideoPortGenericCreate(kGBLineWindowPortYAddress);
-
-        success &= !!driver->windowX & !!driver->windowY;
-
-        driver->compare = GBVideoPortGenericCreate(kGBLineComparePortAddress);
         driver->coordinate = GBCoordPortCreate();
-
-        success &= !!driver->compare & !!driver->coordinate;
-
-        driver->scrollX = GBVideoPortGenericCreate(kGBScrollPortXAddress);
-        driver->scrollY = GBVideoPortGenericCreate(kGBScrollPortYAddress);
-
-        success &= !!driver->scrollX & !!driver->scrollY;
+        success &= !!driver->coordinate;
 
         driver->status = GBLCDStatusPortCreate();
         driver->control = GBLCDControlPortCreate(driver->coordinate);
@@ -321,52 +501,38 @@ GBGraphicsDriver *GBGraphicsDriverCreate(void)
             GBSpriteRAMDestroy(driver->oam);
 
             if (driver->control)
-                free(driver->control);
+                GBRelease(driver->control);
 
             if (driver->status)
-                free(driver->status);
-
-            if (driver->scrollY)
-                free(driver->scrollY);
-
-            if (driver->scrollX)
-                free(driver->scrollX);
+                GBRelease(driver->status);
 
             if (driver->coordinate)
-                free(driver->coordinate);
+                GBRelease(driver->coordinate);
 
-            if (driver->compare)
-                free(driver->compare);
-
-            if (driver->windowY)
-                free(driver->windowY);
-
-            if (driver->windowX)
-                free(driver->windowX);
-
-            if (driver->paletteBG)
-                free(driver->paletteBG);
-
-            if (driver->paletteSprite0)
-                free(driver->paletteSprite0);
-
-            if (driver->paletteSprite1)
-                free(driver->paletteSprite1);
-
-            free(driver);
+            GBRelease(driver);
             return NULL;
         }
 
         bzero(driver->screenData, kGBScreenWidth * kGBScreenHeight * sizeof(uint32_t));
 
+        // Black, the same as an all zero screenData with the default colors
+        driver->indexed = false;
+        memset(driver->screenIndices, kGBShadeBlack, kGBScreenWidth * kGBScreenHeight);
+
         driver->displayOn = false;
 
         driver->driverMode = kGBDriverStateVBlank;
         driver->driverModeTicks = 0;
+        driver->lastTick = 0;
+        driver->frameCount = 0;
 
         driver->linePointer = driver->screenData;
         driver->linePosition = 0;
 
+        // Nothing has been shown yet
+        GBGraphicsDriverDamageAll(driver);
+        driver->lineChanges = 0;
+
         driver->fifoPosition = 0;
         driver->fifoSize = 0;
 
@@ -383,6 +549,11 @@ GBGraphicsDriver *GBGraphicsDriverCreate(void)
         driver->lineMod8 = 0;
         driver->driverX = 0;
 
+        driver->scanline = false;
+        driver->scanlineNext = false;
+        driver->transferClocks = kGBDriverPixelTransferClocks;
+        driver->windowLine = 0;
+
         driver->colorLookup[0] = 0xEEEEEEEE; // white
         driver->colorLookup[1] = 0xBBBBBBBB; // light gray
         driver->colorLookup[2] = 0x55555555; // dark gray
@@ -391,6 +562,7 @@ GBGraphicsDriver *GBGraphicsDriverCreate(void)
         driver->nullColor = 0x00000000;
 
         driver->tick = __GBGraphicsDriverTick;
+        driver->nextEvent = __GBGraphicsDriverNextEvent;
         driver->install = __GBGraphicsDriverInstall;
     }
 
@@ -401,7 +573,77 @@ void GBGraphicsDriverDestroy(GBGraphicsDriver *this)
 {
     GBSpriteRAMDestroy(this->oam);
 
-    free(this);
+    GBRelease(this);
+}
+
+void GBGraphicsDriverSetScanline(GBGraphicsDriver *this, bool enabled)
+{
+    this->scanlineNext = enabled;
+
+    // Blanking runs the same way in both, so there's nothing to wait for
+    if (!this->displayOn || this->driverMode == kGBDriverStateHBlank || this->driverMode == kGBDriverStateVBlank)
+        this->scanline = enabled;
+}
+
+bool GBGraphicsDriverLineDamaged(GBGraphicsDriver *this, uint8_t line)
+{
+    if (line >= kGBScreenHeight)
+        return false;
+
+    return !!(this->damage[line >> 5] & (1U << (line & 0x1F)));
+}
+
+bool GBGraphicsDriverTakeDamage(GBGraphicsDriver *this, uint32_t damage[kGBDriverDamageWords])
+{
+    uint32_t any = 0;
+
+    for (uint8_t i = 0; i < kGBDriverDamageWords; i++)
+    {
+        damage[i] = this->damage[i];
+        any |= this->damage[i];
+
+        this->damage[i] = 0;
+    }
+
+    return !!any;
+}
+
+void GBGraphicsDriverDamageAll(GBGraphicsDriver *this)
+{
+    memset(this->damage, 0xFF, sizeof(this->damage));
+
+    // Keep the bits past the last line clear
+    this->damage[kGBDriverDamageWords - 1] = (kGBScreenHeight % 32) ? ((1U << (kGBScreenHeight % 32)) - 1) : 0xFFFFFFFF;
+}
+
+#pragma mark - Screen Conversion
+
+// Lines are converted separately since `pitch` can have padding
+#define __GBGraphicsDriverConvertLines(this, damage, convert, lookup, pixels, pitch)                          \
+    do {                                                                                                    \
+        for (uint8_t line = 0; line < kGBScreenHeight; line++)                                              \
+        {                                                                                                   \
+            if ((damage) && !((damage)[line >> 5] & (1U << (line & 0x1F))))                                 \
+                continue;                                                                                   \
+                                                                                                            \
+            convert(&(this)->screenIndices[line * kGBScreenWidth], kGBScreenWidth, (lookup),               \
+                    (void *)((uint8_t *)(pixels) + (line * (pitch))));                                      \
+        }                                                                                                   \
+    } while (0)
+
+void GBGraphicsDriverConvertScreen32(GBGraphicsDriver *this, const uint32_t damage[kGBDriverDamageWords], const uint32_t lookup[4], uint32_t *pixels, size_t pitch)
+{
+    __GBGraphicsDriverConvertLines(this, damage, GBShadeConvert32, lookup ? lookup : this->colorLookup, pixels, pitch);
+}
+
+void GBGraphicsDriverConvertScreen16(GBGraphicsDriver *this, const uint32_t damage[kGBDriverDamageWords], const uint16_t lookup[4], uint16_t *pixels, size_t pitch)
+{
+    __GBGraphicsDriverConvertLines(this, damage, GBShadeConvert16, lookup ? lookup : gGBShadeRGB565, pixels, pitch);
+}
+
+void GBGraphicsDriverConvertScreen8(GBGraphicsDriver *this, const uint32_t damage[kGBDriverDamageWords], const uint8_t lookup[4], uint8_t *pixels, size_t pitch)
+{
+    __GBGraphicsDriverConvertLines(this, damage, GBShadeConvert8, lookup ? lookup : gGBShadeGray, pixels, pitch);
 }
 
 bool __GBGraphicsDriverInstall(GBGraphicsDriver *this, struct __GBGameboy *gameboy)
@@ -416,15 +658,17 @@ bool __GBGraphicsDriverInstall(GBGraphicsDriver *this, struct __GBGameboy *gameb
 
     GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->control);
     GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->status);
-    GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->scrollX);
-    GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->scrollY);
     GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->coordinate);
-    GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->compare);
-    GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->windowX);
-    GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->windowY);
-    GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->paletteBG);
-    GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->paletteSprite0);
-    GBIOMapperInstallPort(gameboy->mmio, (GBIORegister *)this->paletteSprite1);
+
+    // These have no side effects, so they live in the mapper's register file
+    this->scrollX = GBIOMapperInstallRegister(gameboy->mmio, kGBScrollPortXAddress, 0x00);
+    this->scrollY = GBIOMapperInstallRegister(gameboy->mmio, kGBScrollPortYAddress, 0x00);
+    this->compare = GBIOMapperInstallRegister(gameboy->mmio, kGBLineComparePortAddress, 0x00);
+    this->windowX = GBIOMapperInstallRegister(gameboy->mmio, kGBLineWindowPortXAddress, 0x00);
+    this->windowY = GBIOMapperInstallRegister(gameboy->mmio, kGBLineWindowPortYAddress, 0x00);
+    this->paletteBG = GBIOMapperInstallRegister(gameboy->mmio, kGBPalettePortBGAddress, 0x00);
+    this->paletteSprite0 = GBIOMapperInstallRegister(gameboy->mmio, kGBPalettePortSprite0Address, 0x00);
+    this->paletteSprite1 = GBIOMapperInstallRegister(gameboy->mmio, kGBPalettePortSprite1Address, 0x00);
 
     return true;
 }
@@ -432,13 +676,25 @@ bool __GBGraphicsDriverInstall(GBGraphicsDriver *this, struct __GBGameboy *gameb
 void __GBGraphicsDriverVBlankReset(GBGraphicsDriver *this)
 {
     this->fetcherBase = (this->control->value & 0x08) ? 0x1C00 : 0x1800;
-    this->fetcherPosition = (this->scrollY->value / kGBTileHeight) * kGBMapWidth;
+    this->fetcherPosition = (*this->scrollY / kGBTileHeight) * kGBMapWidth;
     this->linePointer = this->screenData;
 
-    this->lineMod8 = this->scrollY->value % 8;
+    this->lineMod8 = *this->scrollY % 8;
     this->coordinate->value = 0;
 
     this->fetcherOffset = 0;
+    this->windowLine = 0;
+    this->lineChanges = 0;
+}
+
+void __GBGraphicsDriverEndLine(GBGraphicsDriver *this)
+{
+    uint16_t line = (this->linePointer - this->screenData) / kGBScreenWidth;
+
+    if (this->lineChanges && line < kGBScreenHeight)
+        this->damage[line >> 5] |= (1U << (line & 0x1F));
+
+    this->lineChanges = 0;
 }
 
 void __GBGraphicsDriverSetMode(GBGraphicsDriver *this, uint8_t mode)
@@ -455,10 +711,14 @@ void __GBGraphicsDriverSetMode(GBGraphicsDriver *this, uint8_t mode)
                 (*this->interruptRequest) |= (1 << kGBInterruptLCDStat);
 
             (*this->interruptRequest) |= (1 << kGBInterruptVBlank);
+
+            this->frameCount++;
         } break;
         case kGBDriverStateHBlank: {
             if (this->status->value & kGBVideoInterruptHBlank)
                 (*this->interruptRequest) |= (1 << kGBInterruptLCDStat);
+
+            this->scanline = this->scanlineNext;
         } break;
         case kGBDriverStateSpriteSearch: {
             if (this->status->value & kGBVideoInterruptSpriteSearch)
@@ -469,7 +729,7 @@ void __GBGraphicsDriverSetMode(GBGraphicsDriver *this, uint8_t mode)
 
 void __GBGraphicsDriverCheckCoincidence(GBGraphicsDriver *this)
 {
-    if (this->coordinate->value == this->compare->value) {
+    if (this->coordinate->value == *this->compare) {
         this->status->value |= kGBVideoStatMatchFlag;
 
         if (this->status->value & kGBVideoInterruptOnLine)
@@ -479,13 +739,63 @@ void __GBGraphicsDriverCheckCoincidence(GBGraphicsDriver *this)
     }
 }
 
+static inline void __GBGraphicsDriverPutPixel(GBGraphicsDriver *this, uint8_t shade)
+{
+    if (this->indexed)
+    {
+        uint8_t *index = &this->screenIndices[(this->linePointer - this->screenData) + this->linePosition++];
+
+        this->lineChanges |= *index ^ shade;
+        *index = shade;
+    } else {
+        uint32_t color = this->colorLookup[shade];
+
+        this->lineChanges |= this->linePointer[this->linePosition] ^ color;
+        this->linePointer[this->linePosition++] = color;
+    }
+}
+
 void __GBGraphicsDriverTick(GBGraphicsDriver *this, uint64_t ticks)
 {
+    // Nothing was skipped if the display was just turned on
+    uint64_t skipped = (this->lastTick == kGBClockNever) ? 0 : ticks - this->lastTick - 1;
+    this->lastTick = ticks;
+
     if (!this->displayOn)
         return;
 
+    // Nothing happens during blanking until the end of the line (see below), so we may not have been run on every tick.
+    // In scanline mode that goes for the whole line.
+    if (this->scanline || this->driverMode == kGBDriverStateHBlank || this->driverMode == kGBDriverStateVBlank)
+        this->driverModeTicks += skipped;
+
     this->driverModeTicks++;
 
+    if (this->scanline)
+    {
+        if (this->driverMode == kGBDriverStateSpriteSearch && this->driverModeTicks >= kGBDriverSpriteSearchClocks)
+        {
+            __GBGraphicsDriverSetMode(this, kGBDriverStatePixelTransfer);
+
+            this->driverModeTicks = 0;
+            this->transferClocks = kGBDriverPixelTransferClocks + (*this->scrollX % 8);
+
+            return;
+        }
+
+        if (this->driverMode == kGBDriverStatePixelTransfer && this->driverModeTicks >= this->transferClocks)
+        {
+            __GBGraphicsDriverRenderLine(this);
+            __GBGraphicsDriverEndLine(this);
+            __GBGraphicsDriverSetMode(this, kGBDriverStateHBlank);
+
+            return;
+        }
+
+        if (this->driverMode == kGBDriverStateSpriteSearch || this->driverMode == kGBDriverStatePixelTransfer)
+            return;
+    }
+
     switch (this->driverMode)
     {
         case kGBDriverStateSpriteSearch: {
@@ -567,24 +877,20 @@ void __GBGraphicsDriverTick(GBGraphicsDriver *this, uint64_t ticks)
 
                     switch (palette)
                     {
-                        case 1:  trueColor = this->paletteSprite0->value >> (2 * color); break;
-                        case 2:  trueColor = this->paletteSprite1->value >> (2 * color); break;
-                        default: trueColor = this->paletteBG->value >> (2 * color);      break;
+                        case 1:  trueColor = *this->paletteSprite0 >> (2 * color); break;
+                        case 2:  trueColor = *this->paletteSprite1 >> (2 * color); break;
+                        default: trueColor = *this->paletteBG >> (2 * color);      break;
                     }
 
                     trueColor &= 0x3;
 
-                    // Finally lookup based on selected RGB values
-                    uint32_t nextPixelRGB = this->colorLookup[trueColor];
-
-                    /*if (!(this->linePosition % 8) || !(this->coordinate->value % 8))
-                        nextPixelRGB = 0xFF0000FF;*/
+                    // Finally the shade is drawn (and looked up in colorLookup unless the screen is indexed)
 
                     /*if (trueColor != 0)
-                        printf("Calculated RGB 0x%06X for pixel %d%d with mapped value %d%d\n", nextPixelRGB, color >> 1, color & 1, trueColor >> 1, trueColor & 1);*/
+                        printf("Calculated RGB 0x%06X for pixel %d%d with mapped value %d%d\n", this->colorLookup[trueColor], color >> 1, color & 1, trueColor >> 1, trueColor & 1);*/
 
                     // Output only if we've discarded enough pixels to get to the starting x position
-                    if (!(this->driverX < this->scrollX->value))
+                    if (!(this->driverX < *this->scrollX))
                     {
                         if (this->spriteIndex < this->lineSpriteCount)
                         {
@@ -601,18 +907,18 @@ void __GBGraphicsDriverTick(GBGraphicsDriver *this, uint64_t ticks)
                                 //    printf("Next sprite at (%d, %d)\n", nextSprite->x, nextSprite->y);
 
                                 if (this->control->value & 2) {
-                                    this->linePointer[this->linePosition++] = 0xFF000000;
+                                    __GBGraphicsDriverPutPixel(this, kGBShadeBlack);
                                 } else {
                                     this->linePosition++;
                                 }
                             } else {
-                                this->linePointer[this->linePosition++] = nextPixelRGB;
+                                __GBGraphicsDriverPutPixel(this, trueColor);
                             }
 
                             if (this->linePosition >= spriteRightX)
                                 this->spriteIndex++;
                         } else {
-                            this->linePointer[this->linePosition++] = nextPixelRGB;
+                            __GBGraphicsDriverPutPixel(this, trueColor);
                         }
                     }
 
@@ -626,14 +932,14 @@ void __GBGraphicsDriverTick(GBGraphicsDriver *this, uint64_t ticks)
                     // We clear FIFO and change to the window when we reach its x position
                     /*if (!this->drawingWindow && this->control->value & 0x20) // Check if window enabled
                     {
-                        if (this->coordinate->value >= this->windowY->value && this->driverX >= (this->windowX->value + 7))
+                        if (this->coordinate->value >= *this->windowY && this->driverX >= (*this->windowX + 7))
                         {
                             // 'clear' the FIFO buffer
                             this->fifoPosition = 0;
                             this->fifoSize = 0;
 
                             // Set fetcher offset to the start of the window (on the given row)
-                            uint8_t currentWindowRow = this->coordinate->value - this->windowY->value;
+                            uint8_t currentWindowRow = this->coordinate->value - *this->windowY;
 
                             this->fetcherBase = (this->control->value & 0x40) ? 0x1C00 : 0x1800;
                             this->fetcherPosition = (currentWindowRow / kGBTileHeight) * kGBMapWidth;
@@ -662,9 +968,6 @@ void __GBGraphicsDriverTick(GBGraphicsDriver *this, uint64_t ticks)
                         /*if (this->fetcherTile)
                             printf("Fetcher: Tile 0x%02X read for position 0x%04X at offset 0x%04X [base: 0x%04X]\n", this->fetcherTile, this->fetcherPosition, this->fetcherOffset - 1, this->fetcherBase);*/
 
-                        for (uint8_t i = 0; i < 8; i++)
-                            this->fetchBuffer[i] = 0 /* palette index */;
-
                         this->fetcherMode = kGBFetcherStateFetchByte0;
                     } break;
                     case kGBFetcherStateFetchByte0: {
@@ -677,10 +980,6 @@ void __GBGraphicsDriverTick(GBGraphicsDriver *this, uint64_t ticks)
                         /*if (this->fetcherTile)
                             printf("Tile 0x%02X row 0x%02X byte 0 read as 0x%02X (tileset at 0x8%03X)\n", this->fetcherTile, this->lineMod8, this->fetcherByte0, tileset);*/
 
-                        // Push back first byte of each pixel (into top nibble)
-                        for (uint8_t i = 0; i < 8; i++)
-                            this->fetchBuffer[i] |= ((this->fetcherByte0 >> (7 - i)) & 1) << 4;
-
                         this->fetcherMode = kGBFetcherStateFetchByte1;
                     } break;
                     case kGBFetcherStateFetchByte1: {
@@ -690,14 +989,12 @@ void __GBGraphicsDriverTick(GBGraphicsDriver *this, uint64_t ticks)
 
                         this->fetcherByte1 = this->vram->memory[address];
 
-                        // Push back second byte of each pixel (into top nibble)
-                        for (uint8_t i = 0; i < 8; i++)
-                        {
-                            this->fetchBuffer[i] |= ((this->fetcherByte1 >> (7 - i)) & 1) << 5;
+                        // Both bytes are in, so the decoded row can be used. Colors go in the top nibble (palette 0 is the background).
+                        uint16_t tile = (this->control->value & 0x10) ? this->fetcherTile : (0x80 + this->fetcherTile);
+                        memcpy(this->fetchBuffer, GBVideoRAMTile(this->vram, tile) + (kGBTileWidth * this->lineMod8), kGBTileWidth);
 
-                            /*if (this->fetcherTile)
-                                printf("Tile 0x%02X row 0x%02X pixel %d decoded with value %d\n", this->fetcherTile, this->lineMod8, i, (this->fetchBuffer[i] >> 4));*/
-                        }
+                        for (uint8_t i = 0; i < 8; i++)
+                            this->fetchBuffer[i] <<= 4;
 
                         // The fetcher wraps over x
                         if (this->fetcherOffset >= 32)
@@ -741,6 +1038,7 @@ void __GBGraphicsDriverTick(GBGraphicsDriver *this, uint64_t ticks)
 
             if (this->linePosition == kGBScreenWidth)
             {
+                __GBGraphicsDriverEndLine(this);
                 __GBGraphicsDriverSetMode(this, kGBDriverStateHBlank);
 
                 return;
@@ -814,3 +1112,39 @@ void __GBGraphicsDriverTick(GBGraphicsDriver *this, uint64_t ticks)
         default: fprintf(stderr, "Emulator Error: Invalid LCD driver state '0x%02X'.\n", this->driverMode); break;
     }
 }
+
+uint64_t __GBGraphicsDriverNextEvent(GBGraphicsDriver *this, uint64_t ticks)
+{
+    if (!this->displayOn)
+        return kGBClockNever;
+
+    switch (this->driverMode)
+    {
+        case kGBDriverStateHBlank: {
+            uint16_t remaining = kGBDriverHorizonalClocks - this->driverModeTicks;
+
+            return ticks + (remaining ? remaining : 0x10000);
+        }
+        case kGBDriverStateVBlank: {
+            // The coincidence interrupt is requested again on every tick it matches, so we can't skip those.
+            if ((this->status->value & kGBVideoStatMatchFlag) && (this->status->value & kGBVideoInterruptOnLine))
+                return ticks + 1;
+
+            return ticks + (kGBDriverVerticalClockUpdate - this->driverModeTicks);
+        }
+        case kGBDriverStateSpriteSearch: {
+            if (this->scanline)
+                return (this->driverModeTicks >= kGBDriverSpriteSearchClocks) ? ticks + 1 : ticks + (kGBDriverSpriteSearchClocks - this->driverModeTicks);
+
+            return ticks + 1;
+        }
+        case kGBDriverStatePixelTransfer: {
+            if (this->scanline)
+                return (this->driverModeTicks >= this->transferClocks) ? ticks + 1 : ticks + (this->transferClocks - this->driverModeTicks);
+
+            return ticks + 1;
+        }
+        default:
+            return ticks + 1;
+    }
+}
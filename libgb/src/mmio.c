@@ -5,16 +5,16 @@
 
 #pragma mark - Null port
 
-GBIORegister *gGBIOMapperNullPorts[(kGBIOMapperFinalAddress - kGBIOMapperFirstAddress) + 1];
+GBIORegister *gGBIOMapperNullPorts[kGBIOMapperPortCount];
 
 void __GBIORegisterNullWrite(GBIORegister *reg, uint8_t byte)
 {
-    //fprintf(stderr, "Warning: Attempt to write byte '0x%02X' to nonexistant I/O Port '0x%04X'\n", byte, reg->address);
+    GBDiagnosticsRecord(kGBDiagnosticPortWrite, reg->address);
 }
 
 uint8_t __GBIORegisterNullRead(GBIORegister *reg)
 {
-    fprintf(stderr, "Warning: Attempt to read byte from nonexistant I/O Port '0x%04X'\n", reg->address);
+    GBDiagnosticsRecord(kGBDiagnosticPortRead, reg->address);
 
     return 0xFF;
 }
@@ -35,7 +35,7 @@ uint8_t __GBIORegisterSimpleRead(GBIORegister *reg)
 
 GBIOMapper *GBIOMapperCreate(void)
 {
-    GBIOMapper *mapper = malloc(sizeof(GBIOMapper));
+    GBIOMapper *mapper = GBAllocate(sizeof(GBIOMapper));
 
     if (mapper)
     {
@@ -47,12 +47,22 @@ GBIOMapper *GBIOMapperCreate(void)
         mapper->startAddress = kGBIOMapperFirstAddress;
         mapper->endAddress = kGBIOMapperFinalAddress;
 
-        memcpy(mapper->portMap, gGBIOMapperNullPorts, ((kGBIOMapperFinalAddress - kGBIOMapperFirstAddress) + 1) * sizeof(GBIORegister *));
+        memcpy(mapper->portMap, gGBIOMapperNullPorts, kGBIOMapperPortCount * sizeof(GBIORegister *));
+        memset(mapper->registers, 0xFF, kGBIOMapperPortCount);
+
+        // Until something is installed, every port goes to a null port (which counts the access)
+        memset(mapper->readHooks, 0xFF, sizeof(mapper->readHooks));
+        memset(mapper->writeHooks, 0xFF, sizeof(mapper->writeHooks));
     }
 
     return mapper;
 }
 
+static bool __GBIOMapperHooked(uint32_t *hooks, uint8_t index)
+{
+    return (hooks[index >> 5] >> (index & 0x1F)) & 1;
+}
+
 void GBIOMapperInstallPort(GBIOMapper *mapper, GBIORegister *port)
 {
     if (port->address < kGBIOMapperFirstAddress || kGBIOMapperFinalAddress < port->address)
@@ -61,23 +71,55 @@ void GBIOMapperInstallPort(GBIOMapper *mapper, GBIORegister *port)
         return;
     }
 
-    mapper->portMap[port->address - kGBIOMapperFirstAddress] = port;
+    uint8_t index = port->address - kGBIOMapperFirstAddress;
+
+    mapper->portMap[index] = port;
+    mapper->readHooks[index >> 5] |= (1U << (index & 0x1F));
+    mapper->writeHooks[index >> 5] |= (1U << (index & 0x1F));
+}
+
+uint8_t *GBIOMapperInstallRegister(GBIOMapper *mapper, uint16_t address, uint8_t value)
+{
+    if (address < kGBIOMapperFirstAddress || kGBIOMapperFinalAddress < address)
+    {
+        fprintf(stderr, "Warning: Attempted to install I/O register at memory address out of range! (addr=0x%04X)\n", address);
+        return NULL;
+    }
+
+    uint8_t index = address - kGBIOMapperFirstAddress;
+
+    mapper->portMap[index] = gGBIOMapperNullPorts[index];
+    mapper->readHooks[index >> 5] &= ~(1U << (index & 0x1F));
+    mapper->writeHooks[index >> 5] &= ~(1U << (index & 0x1F));
+
+    mapper->registers[index] = value;
+
+    return &mapper->registers[index];
 }
 
 void GBIOMapperDestroy(GBIOMapper *this)
 {
-    free(this);
+    GBRelease(this);
 }
 
 void __GBIOMapperWrite(GBIOMapper *this, uint16_t address, uint8_t byte)
 {
     if (address < kGBIOMapperFirstAddress || kGBIOMapperFinalAddress < address)
     {
-        fprintf(stderr, "Warning: Attempted write to I/O port at memory address out of range! (addr=0x%04X, byte=0x%02X)\n", address, byte);
+        GBDiagnosticsRecord(kGBDiagnosticPortRange, address);
         return;
     }
 
-    GBIORegister *port = this->portMap[address - kGBIOMapperFirstAddress];
+    uint8_t index = address - kGBIOMapperFirstAddress;
+
+    if (!__GBIOMapperHooked(this->writeHooks, index))
+    {
+        this->registers[index] = byte;
+
+        return;
+    }
+
+    GBIORegister *port = this->portMap[index];
     port->write(port, byte);
 }
 
@@ -85,11 +127,16 @@ uint8_t __GBIOMapperRead(GBIOMapper *this, uint16_t address)
 {
     if (address < kGBIOMapperFirstAddress || kGBIOMapperFinalAddress < address)
     {
-        fprintf(stderr, "Warning: Attempted read to I/O port at memory address out of range! (addr=0x%04X)\n", address);
+        GBDiagnosticsRecord(kGBDiagnosticPortRange, address);
         return 0xFF;
     }
 
-    GBIORegister *port = this->portMap[address - kGBIOMapperFirstAddress];
+    uint8_t index = address - kGBIOMapperFirstAddress;
+
+    if (!__GBIOMapperHooked(this->readHooks, index))
+        return this->registers[index];
+
+    GBIORegister *port = this->portMap[index];
     return port->read(port);
 }
 
@@ -102,7 +149,7 @@ bool __GBIOMapperInstall(GBIOMapper *this, GBGameboy *gameboy)
 
 __attribute__((constructor)) static void __GBIOMapperInitNullPorts(void)
 {
-    uint16_t count = (kGBIOMapperFinalAddress - kGBIOMapperFirstAddress) + 1;
+    uint16_t count = kGBIOMapperPortCount;
 
     for (uint16_t i = 0; i < count; i++)
     {
@@ -124,7 +171,7 @@ __attribute__((constructor)) static void __GBIOMapperInitNullPorts(void)
 
 __attribute__((destructor)) static void __GBIOMapperDestroyNullPorts(void)
 {
-    uint16_t count = (kGBIOMapperFinalAddress - kGBIOMapperFirstAddress) + 1;
+    uint16_t count = kGBIOMapperPortCount;
 
     for (uint16_t i = 0; i < count; i++)
         free(gGBIOMapperNullPorts[i]);
@@ -8,12 +8,12 @@ GBMemorySpace *gGBMemorySpaceNull;
 
 void __GBMemorySpaceNullWrite(GBMemorySpace *space, uint16_t address, uint8_t byte)
 {
-    fprintf(stderr, "Warning: Attempted write to unmapped address '0x%04X' (byte=0x%02X)\n", address, byte);
+    GBDiagnosticsRecord(kGBDiagnosticUnmappedWrite, address);
 }
 
 uint8_t __GBMemorySpaceNullRead(GBMemorySpace *space, uint16_t address)
 {
-    fprintf(stderr, "Warning: Attempted read to unmapped address '0x%04X'\n", address);
+    GBDiagnosticsRecord(kGBDiagnosticUnmappedRead, address);
     return 0xFF;
 }
 
@@ -24,7 +24,7 @@ bool gGBMemoryManagerROMDefault = true;
 
 GBMemoryManager *GBMemoryManagerCreate(void)
 {
-    GBMemoryManager *mmu = malloc(sizeof(GBMemoryManager));
+    GBMemoryManager *mmu = GBAllocate(sizeof(GBMemoryManager));
 
     if (mmu)
     {
@@ -37,14 +37,29 @@ GBMemoryManager *GBMemoryManagerCreate(void)
         mmu->romMasked = &gGBMemoryManagerROMDefault;
         mmu->romSpace = gGBMemorySpaceNull;
 
+        for (uint16_t i = 0; i < kGBMemoryPageCount; i++)
+        {
+            mmu->readPages[i] = NULL;
+            mmu->writePages[i] = NULL;
+        }
+
+        mmu->biosPage = NULL;
+        mmu->cartPage = NULL;
+
         mmu->install = NULL;
 
         mmu->isWrite = false;
+        mmu->busWritten = false;
+        mmu->synchronous = false;
+
+        mmu->codeMap = NULL;
+        mmu->codeWritten = false;
         mmu->accessed = NULL;
         mmu->mdr = NULL;
         mmu->mar = NULL;
 
         mmu->tick = __GBMemoryManagerTick;
+        mmu->nextEvent = __GBMemoryManagerNextEvent;
     }
 
     return mmu;
@@ -87,11 +102,73 @@ bool GBMemoryManagerInstallSpace(GBMemoryManager *this, GBMemorySpace *space)
 
 void GBMemoryManagerDestroy(GBMemoryManager *this)
 {
-    free(this);
+    GBRelease(this);
+}
+
+#pragma mark - Pages
+
+void GBMemoryManagerMapPages(GBMemoryManager *this, uint16_t start, uint16_t end, uint8_t *read, uint8_t *write)
+{
+    // Counted wider than the page numbers so the loop still ends if `last` is at the top of a 16 bit range
+    uint32_t first = start >> kGBMemoryPageShift;
+    uint32_t last = end >> kGBMemoryPageShift;
+
+    for (uint32_t i = first; i < last + 1; i++)
+    {
+        uint32_t offset = (i - first) << kGBMemoryPageShift;
+        uint8_t *page = read ? read + offset : NULL;
+
+        if (!i && this->biosPage) {
+            this->cartPage = page;
+        } else {
+            this->readPages[i] = page;
+        }
+
+        this->writePages[i] = write ? write + offset : NULL;
+    }
+}
+
+void GBMemoryManagerUnmapPages(GBMemoryManager *this, uint16_t start, uint16_t end)
+{
+    GBMemoryManagerMapPages(this, start, end, NULL, NULL);
 }
 
+void GBMemoryManagerMapBIOS(GBMemoryManager *this, uint8_t *data)
+{
+    if (data) {
+        if (!this->biosPage)
+            this->cartPage = this->readPages[0];
+
+        this->readPages[0] = data;
+    } else if (this->biosPage) {
+        this->readPages[0] = this->cartPage;
+        this->cartPage = NULL;
+    }
+
+    this->biosPage = data;
+}
+
+#pragma mark - Access
+
 void __GBMemoryManagerWrite(GBMemoryManager *this, uint16_t address, uint8_t byte)
 {
+    if (this->codeMap)
+    {
+        uint16_t line = address >> kGBDecodeCacheLineShift;
+
+        if (this->codeMap[line >> 3] & (1 << (line & 7)))
+            this->codeWritten = true;
+    }
+
+    uint8_t *page = this->writePages[address >> kGBMemoryPageShift];
+
+    if (page)
+    {
+        page[address & (kGBMemoryPageSize - 1)] = byte;
+
+        return;
+    }
+
     if (address >= 0xFE00) {
         // high memory
         if (address == 0xFFFF)
@@ -117,6 +194,11 @@ void __GBMemoryManagerWrite(GBMemoryManager *this, uint16_t address, uint8_t byt
 
 uint8_t __GBMemoryManagerRead(GBMemoryManager *this, uint16_t address)
 {
+    uint8_t *page = this->readPages[address >> kGBMemoryPageShift];
+
+    if (page)
+        return page[address & (kGBMemoryPageSize - 1)];
+
     if (address < 0x100 && !(*this->romMasked)) {
         // read rom
         return this->romSpace->read(this->romSpace, address);
@@ -152,44 +234,24 @@ void GBMemoryManagerReadRequest(GBMemoryManager *this, uint16_t *mar, uint8_t *m
     this->isWrite = false;
 }
 
-void __GBMemoryManagerTick(GBMemoryManager *this, uint64_t tick)
+// Only high RAM can be accessed during DMA
+static bool __GBMemoryManagerBusAllows(GBMemoryManager *this, uint16_t address)
 {
-    // We tick at 1 MHz
-    if (tick % 4)
-        return;
+    return !(*this->dma) || (address >= kGBHighRAMStart && address <= kGBHighRAMEnd);
+}
 
+void GBMemoryManagerService(GBMemoryManager *this)
+{
     if (this->mar && this->mdr)
     {
-        if (!(*this->dma)) {
-            if (this->isWrite) {
-                __GBMemoryManagerWrite(this, *this->mar, *this->mdr);
-            } else {
-                (*this->mdr) = __GBMemoryManagerRead(this, *this->mar);
-            }
-        } else {
-            if ((*this->mar) < kGBHighRAMStart)
-            {
-                if (!this->isWrite)
-                    (*this->mdr) = 0xFF;
-
-                (*this->accessed) = true;
-                return;
-            }
-
-            if ((*this->mar) > kGBHighRAMEnd)
-            {
-                if (!this->isWrite)
-                    (*this->mdr) = 0xFF;
-
-                (*this->accessed) = true;
-                return;
-            }
-
+        if (__GBMemoryManagerBusAllows(this, *this->mar)) {
             if (this->isWrite) {
                 __GBMemoryManagerWrite(this, *this->mar, *this->mdr);
             } else {
                 (*this->mdr) = __GBMemoryManagerRead(this, *this->mar);
             }
+        } else if (!this->isWrite) {
+            (*this->mdr) = 0xFF;
         }
 
         // Prevent repeated writing while other hardware may modify the *mar byte.
@@ -200,6 +262,40 @@ void __GBMemoryManagerTick(GBMemoryManager *this, uint64_t tick)
     }
 }
 
+void GBMemoryManagerBusWrite(GBMemoryManager *this, uint16_t address, uint8_t byte)
+{
+    this->busWritten = true;
+
+    if (__GBMemoryManagerBusAllows(this, address))
+        __GBMemoryManagerWrite(this, address, byte);
+}
+
+uint8_t GBMemoryManagerBusRead(GBMemoryManager *this, uint16_t address)
+{
+    if (!__GBMemoryManagerBusAllows(this, address))
+        return 0xFF;
+
+    return __GBMemoryManagerRead(this, address);
+}
+
+void __GBMemoryManagerTick(GBMemoryManager *this, uint64_t tick)
+{
+    // We tick at 1 MHz
+    if (tick % 4)
+        return;
+
+    GBMemoryManagerService(this);
+}
+
+uint64_t __GBMemoryManagerNextEvent(GBMemoryManager *this, uint64_t tick)
+{
+    if (!this->mar || !this->mdr)
+        return kGBClockNever;
+
+    // Requests are only serviced on the next memory line tick.
+    return (tick & ~3ULL) + 4;
+}
+
 #pragma mark - Initializer
 
 __attribute__((constructor)) static void __GBMemoryManagerInitNullSpace(void)
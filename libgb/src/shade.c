@@ -0,0 +1,125 @@
+#include <libgb/shade.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+const uint16_t gGBShadeRGB565[4] = { 0xEF7D, 0xBDD7, 0x52AA, 0x0000 };
+const uint8_t gGBShadeGray[4] = { 0xEE, 0xBB, 0x55, 0x00 };
+
+#if defined(__SSE2__)
+
+// The next 16 shades, with one byte mask per shade (all ones where a pixel has that shade)
+static inline void __GBShadeMasks(const uint8_t *shades, __m128i masks[4])
+{
+    __m128i index = _mm_and_si128(_mm_loadu_si128((const __m128i *)shades), _mm_set1_epi8(3));
+
+    for (int8_t shade = 0; shade < 4; shade++)
+        masks[shade] = _mm_cmpeq_epi8(index, _mm_set1_epi8(shade));
+}
+
+// Pick each lane's color out of the 4 by its mask
+static inline __m128i __GBShadeSelect(const __m128i masks[4], const __m128i colors[4])
+{
+    __m128i result = _mm_and_si128(masks[0], colors[0]);
+
+    for (uint8_t shade = 1; shade < 4; shade++)
+        result = _mm_or_si128(result, _mm_and_si128(masks[shade], colors[shade]));
+
+    return result;
+}
+
+#endif /* defined(__SSE2__) */
+
+#pragma mark - Conversion
+
+void GBShadeConvert32(const uint8_t *shades, size_t count, const uint32_t lookup[4], uint32_t *pixels)
+{
+#if defined(__SSE2__)
+    {
+        __m128i colors[4];
+
+        for (uint8_t shade = 0; shade < 4; shade++)
+            colors[shade] = _mm_set1_epi32(lookup[shade]);
+
+        for ( ; count >= 16; count -= 16, shades += 16, pixels += 16)
+        {
+            __m128i masks[4];
+            __GBShadeMasks(shades, masks);
+
+            // Byte masks are widened by unpacking them with themselves, 4 pixels to a register
+            for (uint8_t quarter = 0; quarter < 4; quarter++)
+            {
+                __m128i wide[4];
+
+                for (uint8_t shade = 0; shade < 4; shade++)
+                {
+                    __m128i half = (quarter < 2) ? _mm_unpacklo_epi8(masks[shade], masks[shade]) : _mm_unpackhi_epi8(masks[shade], masks[shade]);
+
+                    wide[shade] = (quarter & 1) ? _mm_unpackhi_epi16(half, half) : _mm_unpacklo_epi16(half, half);
+                }
+
+                _mm_storeu_si128((__m128i *)(pixels + (4 * quarter)), __GBShadeSelect(wide, colors));
+            }
+        }
+    }
+#endif
+
+    for ( ; count; count--)
+        *pixels++ = lookup[*shades++ & 3];
+}
+
+void GBShadeConvert16(const uint8_t *shades, size_t count, const uint16_t lookup[4], uint16_t *pixels)
+{
+#if defined(__SSE2__)
+    {
+        __m128i colors[4];
+
+        for (uint8_t shade = 0; shade < 4; shade++)
+            colors[shade] = _mm_set1_epi16(lookup[shade]);
+
+        for ( ; count >= 16; count -= 16, shades += 16, pixels += 16)
+        {
+            __m128i masks[4];
+            __GBShadeMasks(shades, masks);
+
+            __m128i low[4], high[4];
+
+            for (uint8_t shade = 0; shade < 4; shade++)
+            {
+                low[shade] = _mm_unpacklo_epi8(masks[shade], masks[shade]);
+                high[shade] = _mm_unpackhi_epi8(masks[shade], masks[shade]);
+            }
+
+            _mm_storeu_si128((__m128i *)(pixels + 0), __GBShadeSelect(low, colors));
+            _mm_storeu_si128((__m128i *)(pixels + 8), __GBShadeSelect(high, colors));
+        }
+    }
+#endif
+
+    for ( ; count; count--)
+        *pixels++ = lookup[*shades++ & 3];
+}
+
+void GBShadeConvert8(const uint8_t *shades, size_t count, const uint8_t lookup[4], uint8_t *pixels)
+{
+#if defined(__SSE2__)
+    {
+        __m128i colors[4];
+
+        for (uint8_t shade = 0; shade < 4; shade++)
+            colors[shade] = _mm_set1_epi8(lookup[shade]);
+
+        for ( ; count >= 16; count -= 16, shades += 16, pixels += 16)
+        {
+            __m128i masks[4];
+            __GBShadeMasks(shades, masks);
+
+            _mm_storeu_si128((__m128i *)pixels, __GBShadeSelect(masks, colors));
+        }
+    }
+#endif
+
+    for ( ; count; count--)
+        *pixels++ = lookup[*shades++ & 3];
+}
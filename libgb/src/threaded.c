@@ -0,0 +1,112 @@
+#include <libgb/gameboy.h>
+#include <stdio.h>
+
+#pragma mark - Instruction Helpers
+
+// Only take the memory access and ALU helpers here. The ops themselves are expanded inside GBProcessorThreadedStep.
+#define kGBInstructionSetHelpersOnly 1
+#include "指令集.h"
+#undef kGBInstructionSetHelpersOnly
+
+#undef op
+#undef op_pre
+#undef declare
+#undef op_return
+
+#pragma mark - Threaded Core
+
+// With GCC and clang every op gets its own indirect jump from a label table.
+// Other compilers get one switch on the opcode (prefixed ops are at 0x100 + opcode).
+#if defined(__GNUC__) || defined(__clang__)
+    #define kGBThreadedComputedGoto 1
+#endif /* defined(__GNUC__) || defined(__clang__) */
+
+#ifdef kGBThreadedComputedGoto
+    #define __GBThreadedLabel(label, value) label
+#else /* !defined(kGBThreadedComputedGoto) */
+    #define __GBThreadedLabel(label, value) case value: label
+#endif /* defined(kGBThreadedComputedGoto) */
+
+// Each op is a block in GBProcessorThreadedStep. A step ends early by breaking out of the block.
+// After the step, service its access and jump straight back into the same op if it isn't done yet.
+#define __GBThreadedOp(label, value, impl)                                  \
+    __GBThreadedLabel(label, value):                                        \
+        do impl while (0);                                                  \
+                                                                            \
+        __GBProcessorFastAccess(cpu);                                       \
+                                                                            \
+        if (cpu->state.mode > kGBProcessorModeFetch)                        \
+            goto label;                                                     \
+                                                                            \
+        return cpu->state.cycles;
+
+#define op(code, len, str, impl)                                            \
+    __GBThreadedOp(__GBThreadedOp_ ## code, code, impl)
+
+#define op_pre(code, len, str, impl)                                        \
+    __GBThreadedOp(__GBThreadedOp_pre_ ## code, 0x100 | code, impl)
+
+#define op_return break
+
+// The op bodies expect the processor to be called cpu.
+uint16_t GBProcessorThreadedStep(GBProcessor *cpu)
+{
+    if (!__GBProcessorFastFetch(cpu))
+        return cpu->state.cycles;
+
+#ifdef kGBThreadedComputedGoto
+    #define expand(v, p)                                                                                        \
+        &&__GBThreadedOp_ ## p ## v ## 0, &&__GBThreadedOp_ ## p ## v ## 1, &&__GBThreadedOp_ ## p ## v ## 2,   \
+        &&__GBThreadedOp_ ## p ## v ## 3, &&__GBThreadedOp_ ## p ## v ## 4, &&__GBThreadedOp_ ## p ## v ## 5,   \
+        &&__GBThreadedOp_ ## p ## v ## 6, &&__GBThreadedOp_ ## p ## v ## 7, &&__GBThreadedOp_ ## p ## v ## 8,   \
+        &&__GBThreadedOp_ ## p ## v ## 9, &&__GBThreadedOp_ ## p ## v ## A, &&__GBThreadedOp_ ## p ## v ## B,   \
+        &&__GBThreadedOp_ ## p ## v ## C, &&__GBThreadedOp_ ## p ## v ## D, &&__GBThreadedOp_ ## p ## v ## E,   \
+        &&__GBThreadedOp_ ## p ## v ## F
+
+    static const void *const dispatch[0x100] = {
+        expand(0, 0x), expand(1, 0x), expand(2, 0x), expand(3, 0x),
+        expand(4, 0x), expand(5, 0x), expand(6, 0x), expand(7, 0x),
+        expand(8, 0x), expand(9, 0x), expand(A, 0x), expand(B, 0x),
+        expand(C, 0x), expand(D, 0x), expand(E, 0x), expand(F, 0x)
+    };
+
+    static const void *const dispatchCB[0x100] = {
+        expand(0x0, pre_),  expand(0x1, pre_), expand(0x2, pre_), expand(0x3, pre_),
+        expand(0x4, pre_),  expand(0x5, pre_), expand(0x6, pre_), expand(0x7, pre_),
+        expand(0x8, pre_),  expand(0x9, pre_), expand(0xA, pre_), expand(0xB, pre_),
+        expand(0xC, pre_),  expand(0xD, pre_), expand(0xE, pre_), expand(0xF, pre_)
+    };
+
+    #undef expand
+
+    if (cpu->state.prefix) {
+        goto *dispatchCB[cpu->state.op];
+    } else {
+        goto *dispatch[cpu->state.op];
+    }
+#else /* !defined(kGBThreadedComputedGoto) */
+    switch ((cpu->state.prefix << 8) | cpu->state.op)
+    {
+#endif /* defined(kGBThreadedComputedGoto) */
+
+    #define kGBInstructionSetOpsOnly 1
+    #include "指令集.h"
+    #undef kGBInstructionSetOpsOnly
+
+#ifndef kGBThreadedComputedGoto
+    }
+#endif /* !defined(kGBThreadedComputedGoto) */
+
+    return cpu->state.cycles;
+}
+
+#undef op
+#undef op_pre
+
+#undef __GBThreadedOp
+#undef __GBThreadedLabel
+
+void __GBProcessorThreadedTick(GBProcessor *this, uint64_t tick)
+{
+    GBProcessorThreadedStep(this);
+}
@@ -0,0 +1,91 @@
+#include <libgb/tile.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+// Selects bit 7 for the first pixel in memory down to bit 0 for the last
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    #define kGBTileBitMask 0x8040201008040201ULL
+#else
+    #define kGBTileBitMask 0x0102040810204080ULL
+#endif
+
+#pragma mark - Rows
+
+// One byte per bit of `byte` (1 if set), leftmost pixel first
+static inline uint64_t __GBTileSpread(uint8_t byte)
+{
+    uint64_t bits = (byte * 0x0101010101010101ULL) & kGBTileBitMask;
+
+    // A set bit carries into the top of its byte, and never any further
+    return ((bits + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL;
+}
+
+void GBTileDecodeRow(uint8_t low, uint8_t high, uint8_t pixels[kGBTileRowPixels])
+{
+    uint64_t row = __GBTileSpread(low) | (__GBTileSpread(high) << 1);
+
+    memcpy(pixels, &row, kGBTileRowPixels);
+}
+
+#pragma mark - Batches
+
+void GBTileDecodeRows(const uint8_t *data, size_t count, uint8_t *pixels)
+{
+#if defined(__AVX2__)
+    {
+        // Four rows at a time. Every byte of the lows is its row's first byte, and the same for the highs with the second.
+        const __m256i lowIndex = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 4, 4, 4, 4, 4, 4, 4, 4, 6, 6, 6, 6, 6, 6, 6, 6);
+        const __m256i highIndex = _mm256_add_epi8(lowIndex, _mm256_set1_epi8(1));
+        const __m256i mask = _mm256_set1_epi64x(kGBTileBitMask);
+
+        for ( ; count >= 4; count -= 4, data += 4 * kGBTileRowBytes, pixels += 4 * kGBTileRowPixels)
+        {
+            uint64_t rows;
+            memcpy(&rows, data, sizeof(rows));
+
+            __m256i source = _mm256_set1_epi64x(rows);
+            __m256i low = _mm256_and_si256(_mm256_shuffle_epi8(source, lowIndex), mask);
+            __m256i high = _mm256_and_si256(_mm256_shuffle_epi8(source, highIndex), mask);
+
+            low = _mm256_and_si256(_mm256_cmpeq_epi8(low, mask), _mm256_set1_epi8(1));
+            high = _mm256_and_si256(_mm256_cmpeq_epi8(high, mask), _mm256_set1_epi8(2));
+
+            _mm256_storeu_si256((__m256i *)pixels, _mm256_or_si256(low, high));
+        }
+    }
+#endif
+
+#if defined(__SSE2__)
+    {
+        // Two rows at a time. SSE2 has no byte shuffle, so the bytes are spread out by unpacking them with themselves.
+        const __m128i mask = _mm_set1_epi64x(kGBTileBitMask);
+
+        for ( ; count >= 2; count -= 2, data += 2 * kGBTileRowBytes, pixels += 2 * kGBTileRowPixels)
+        {
+            uint32_t rows;
+            memcpy(&rows, data, sizeof(rows));
+
+            __m128i source = _mm_cvtsi32_si128(rows);               // l0 h0 l1 h1
+            source = _mm_unpacklo_epi8(source, source);             // Each twice
+            source = _mm_unpacklo_epi16(source, source);            // Each 4 times
+
+            __m128i row0 = _mm_unpacklo_epi32(source, source);      // l0 x 8, h0 x 8
+            __m128i row1 = _mm_unpackhi_epi32(source, source);      // l1 x 8, h1 x 8
+
+            __m128i low = _mm_and_si128(_mm_unpacklo_epi64(row0, row1), mask);
+            __m128i high = _mm_and_si128(_mm_unpackhi_epi64(row0, row1), mask);
+
+            low = _mm_and_si128(_mm_cmpeq_epi8(low, mask), _mm_set1_epi8(1));
+            high = _mm_and_si128(_mm_cmpeq_epi8(high, mask), _mm_set1_epi8(2));
+
+            _mm_storeu_si128((__m128i *)pixels, _mm_or_si128(low, high));
+        }
+    }
+#endif
+
+    for ( ; count; count--, data += kGBTileRowBytes, pixels += kGBTileRowPixels)
+        GBTileDecodeRow(data[0], data[1], pixels);
+}
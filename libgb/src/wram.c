@@ -10,7 +10,7 @@
 
 GBHighRAM *GBHighRAMCreate(void)
 {
-    GBHighRAM *ram = malloc(sizeof(GBHighRAM));
+    GBHighRAM *ram = GBAllocate(sizeof(GBHighRAM));
 
     if (ram)
     {
@@ -36,7 +36,7 @@ GBHighRAM *GBHighRAMCreate(void)
 
 void GBHighRAMDestroy(GBHighRAM *this)
 {
-    free(this);
+    GBRelease(this);
 }
 
 void __GBHighRAMWrite(GBHighRAM *this, uint16_t address, uint8_t byte)
@@ -70,7 +70,7 @@ uint8_t __GBHighRAMRead(GBHighRAM *this, uint16_t address)
 
 GBWorkRAM *GBWorkRAMCreate(void)
 {
-    GBWorkRAM *ram = malloc(sizeof(GBWorkRAM));
+    GBWorkRAM *ram = GBAllocate(sizeof(GBWorkRAM));
 
     if (ram)
     {
@@ -78,7 +78,7 @@ GBWorkRAM *GBWorkRAMCreate(void)
 
         if (!ram->hram)
         {
-            free(ram);
+            GBRelease(ram);
 
             return NULL;
         }
@@ -104,7 +104,7 @@ GBWorkRAM *GBWorkRAMCreate(void)
 
 void GBWorkRAMDestroy(GBWorkRAM *this)
 {
-    free(this);
+    GBRelease(this);
 }
 
 void __GBWorkRAMWrite(GBWorkRAM *this, uint16_t address, uint8_t byte)
@@ -122,5 +122,9 @@ bool __GBWorkRAMOnInstall(GBWorkRAM *this, GBGameboy *gameboy)
     bool success = GBMemoryManagerInstallSpace(gameboy->cpu->mmu, (GBMemorySpace *)this);
     success &= GBMemoryManagerInstallSpace(gameboy->cpu->mmu, (GBMemorySpace *)this->hram);
 
+    // High RAM shares its page with MMIO, so only work RAM can be mapped directly
+    if (success)
+        GBMemoryManagerMapPages(gameboy->cpu->mmu, kGBWorkRAMStart, kGBWorkRAMEnd, this->memory, this->memory);
+
     return success;
 }
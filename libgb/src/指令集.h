@@ -2,8 +2,16 @@
 // To create a disassembler, just redefine the op macros such that the implementation is left empty
 // and you have an effective map of opcode --> string and length.
 // Then, disassembly is pretty easy, it's just a simple map
+//
+// The threaded core includes this file twice: once with kGBInstructionSetHelpersOnly for the helpers,
+// then with kGBInstructionSetOpsOnly inside its step function, where each op becomes a labelled block.
+// Ops end a step early with op_return so the threaded core can turn it into a jump.
 
-#ifndef kGBDisassembler
+#ifndef op_return
+    #define op_return return
+#endif /* !defined(op_return) */
+
+#if !defined(kGBDisassembler) && !defined(kGBInstructionSetOpsOnly)
 
 #if __has_attribute(always_inline)
     #define INLINE __attribute__((always_inline))
@@ -40,20 +48,42 @@
 
 #pragma mark - Memory Access
 
+// On a synchronous bus the access is finished (and paid for) before these return.
+// Otherwise the memory manager services it on its next tick, or __GBProcessorFastAccess does.
 static INLINE void __GBProcessorRead(GBProcessor *cpu, uint16_t address)
 {
-    cpu->state.accessed = false;
     cpu->state.mar = address;
 
+    if (cpu->mmu->synchronous)
+    {
+        cpu->state.mdr = GBMemoryManagerBusRead(cpu->mmu, address);
+        cpu->state.accessed = true;
+        cpu->state.cycles += kGBProcessorAccessCycles;
+
+        return;
+    }
+
+    cpu->state.accessed = false;
+
     GBMemoryManagerReadRequest(cpu->mmu, &cpu->state.mar, &cpu->state.mdr, &cpu->state.accessed);
 }
 
 static INLINE void __GBProcessorWrite(GBProcessor *cpu, uint16_t address, uint8_t data)
 {
-    cpu->state.accessed = false;
     cpu->state.mar = address;
     cpu->state.mdr = data;
 
+    if (cpu->mmu->synchronous)
+    {
+        GBMemoryManagerBusWrite(cpu->mmu, address, data);
+        cpu->state.accessed = true;
+        cpu->state.cycles += kGBProcessorAccessCycles;
+
+        return;
+    }
+
+    cpu->state.accessed = false;
+
     GBMemoryManagerWriteRequest(cpu->mmu, &cpu->state.mar, &cpu->state.mdr, &cpu->state.accessed);
 }
 
@@ -62,6 +92,20 @@ static INLINE void __GBProcessorReadArgument(GBProcessor *cpu)
     __GBProcessorRead(cpu, cpu->state.pc++);
 }
 
+// Service the access the current op is waiting for right away. Each access takes one memory line tick.
+// Nothing is ever waiting on a synchronous bus.
+static INLINE void __GBProcessorFastAccess(GBProcessor *cpu)
+{
+    if (cpu->mmu->mar != &cpu->state.mar)
+        return;
+
+    if (cpu->mmu->isWrite)
+        cpu->mmu->busWritten = true;
+
+    GBMemoryManagerService(cpu->mmu);
+    cpu->state.cycles += kGBProcessorAccessCycles;
+}
+
 #pragma mark - ALU
 
 static INLINE uint16_t __ALUComplement(uint8_t value)
@@ -78,51 +122,138 @@ static INLINE uint16_t __ALUSignExtend(uint8_t value)
     }
 }
 
-// Note: Subtract just sets the n flag in f
-static INLINE void __ALUAdd8(GBProcessor *cpu, uint8_t *to, uint8_t from, uint8_t carry)
+#pragma mark - Flags
+
+// Work out f from the last op which set every flag (see kGBProcessorLazyFlags)
+static void __ALUResolveFlags(GBProcessor *cpu)
 {
-    // Perform two 4-bit adds (this is how the gameboy actually does this)
-    uint8_t lo = (from & 0xF) + ((*to) & 0xF) + carry;
-    cpu->state.f.h = lo >> 4;
+    uint8_t left = cpu->state.lazy.left;
+    uint8_t right = cpu->state.lazy.right;
+    uint8_t carry = cpu->state.lazy.carry;
+    uint8_t flags;
+
+    switch (cpu->state.lazy.op)
+    {
+        case kGBLazyFlagsNone:
+            return;
+        case kGBLazyFlagsAdd:
+            flags = gGBALUAdd[carry][(left << 8) | right];
+        break;
+        case kGBLazyFlagsSub:
+            flags = gGBALUSub[carry][(left << 8) | right];
+        break;
+        case kGBLazyFlagsInc:
+            flags = (gGBALUAdd[0][(left << 8) | 1] & ~kGBFlagCarry) | (carry ? kGBFlagCarry : 0);
+        break;
+        case kGBLazyFlagsDec:
+            flags = (gGBALUSub[0][(left << 8) | 1] & ~kGBFlagCarry) | (carry ? kGBFlagCarry : 0);
+        break;
+        case kGBLazyFlagsAnd:
+            flags = (cpu->state.lazy.result ? 0 : kGBFlagZero) | kGBFlagHalfCarry;
+        break;
+        default:
+            flags = (cpu->state.lazy.result ? 0 : kGBFlagZero);
+        break;
+    }
+
+    cpu->state.f.reg = (cpu->state.f.reg & ~kGBFlagMask) | (flags & kGBFlagMask);
+    cpu->state.lazy.op = kGBLazyFlagsNone;
+}
 
-    uint8_t hi = (from >> 4) + ((*to) >> 4) + cpu->state.f.h;
-    cpu->state.f.c = hi >> 4;
+// Set every flag at once. Anything still pending is thrown away.
+static INLINE void __ALUStoreFlags(GBProcessor *cpu, uint8_t flags)
+{
+    cpu->state.f.reg = (cpu->state.f.reg & ~kGBFlagMask) | (flags & kGBFlagMask);
+    cpu->state.lazy.op = kGBLazyFlagsNone;
+}
 
-    (*to) = (hi << 4) | (lo & 0xF);
+// Every other read (and partial write) of f goes through here
+static INLINE GBProcessorFlags *__ALUFlagsPointer(GBProcessor *cpu)
+{
+    if (cpu->state.lazy.op)
+        __ALUResolveFlags(cpu);
 
-    cpu->state.f.z = !(*to);
-    cpu->state.f.n = 0;
+    return &cpu->state.f;
+}
+
+#define __ALUFlags(cpu) (*__ALUFlagsPointer(cpu))
+
+// The two flags branches look at can be read straight from a pending op
+static INLINE uint8_t __ALUZero(GBProcessor *cpu)
+{
+    if (cpu->state.lazy.op)
+        return !cpu->state.lazy.result;
+
+    return cpu->state.f.z;
+}
+
+static INLINE uint8_t __ALUCarry(GBProcessor *cpu)
+{
+    switch (cpu->state.lazy.op)
+    {
+        case kGBLazyFlagsNone:  return cpu->state.f.c;
+        case kGBLazyFlagsAdd:   return (cpu->state.lazy.left + cpu->state.lazy.right + cpu->state.lazy.carry) >> 8;
+        case kGBLazyFlagsSub:   return cpu->state.lazy.result >> 7;
+        case kGBLazyFlagsInc:
+        case kGBLazyFlagsDec:   return cpu->state.lazy.carry;
+        default:                return 0;
+    }
+}
+
+static INLINE void __ALUSetFlags(GBProcessor *cpu, uint8_t op, uint8_t left, uint8_t right, uint8_t carry, uint8_t result)
+{
+    cpu->state.lazy.op = op;
+    cpu->state.lazy.left = left;
+    cpu->state.lazy.right = right;
+    cpu->state.lazy.carry = carry;
+    cpu->state.lazy.result = result;
+
+    #if !kGBProcessorLazyFlags
+        __ALUResolveFlags(cpu);
+    #endif /* !kGBProcessorLazyFlags */
+}
+
+#pragma mark - Arithmetic
+
+static INLINE void __ALUAdd8(GBProcessor *cpu, uint8_t *to, uint8_t from, uint8_t carry)
+{
+    uint8_t result = (*to) + from + carry;
+
+    __ALUSetFlags(cpu, kGBLazyFlagsAdd, (*to), from, carry, result);
+    (*to) = result;
 }
 
 static INLINE void __ALUAdd16(GBProcessor *cpu, uint16_t *to, uint16_t from, uint8_t carry)
 {
     // Perform two 8-bit adds (four 4-bit adds). Flags should automatically be right.
     __ALUAdd8(cpu, (uint8_t *)(to) + 0, from & 0xFF, carry);
-    __ALUAdd8(cpu, (uint8_t *)(to) + 1, from >> 8, cpu->state.f.c);
+    __ALUAdd8(cpu, (uint8_t *)(to) + 1, from >> 8, __ALUCarry(cpu));
 }
 
+// Note: Subtract just sets the n flag in f
 static INLINE void __ALUSub8(GBProcessor *cpu, uint8_t *to, uint8_t from, uint8_t carry)
 {
     // I remembered how to 2's complement
+    uint8_t result = (*to) + (~from + 1) - (~carry + 1);
 
-    /*__ALUAdd8(cpu, to, __ALUComplement(from), ~carry);
-
-    cpu->state.f.n = 1;
+    __ALUSetFlags(cpu, kGBLazyFlagsSub, (*to), from, carry, result);
+    (*to) = result;
+}
 
-    // The gameboy flips these for some reason...
-    if (cpu->state.f.n)
-    {
-        cpu->state.f.c = ~cpu->state.f.c;
-        cpu->state.f.h = ~cpu->state.f.h;
-    }*/
+// inc and dec leave the carry flag alone
+static INLINE void __ALUInc8(GBProcessor *cpu, uint8_t *to)
+{
+    uint8_t result = (*to) + 1;
 
-    uint8_t result = (*to) + (~from + 1) - (~carry + 1);
+    __ALUSetFlags(cpu, kGBLazyFlagsInc, (*to), 1, __ALUCarry(cpu), result);
+    (*to) = result;
+}
 
-    cpu->state.f.z = !result;
-    cpu->state.f.n = 1;
-    cpu->state.f.h = !!((((*to) & 0x0F) + ((~from + 1) & 0x0F)) & 0x08);
-    cpu->state.f.c = !!(result & 0x80);
+static INLINE void __ALUDec8(GBProcessor *cpu, uint8_t *to)
+{
+    uint8_t result = (*to) - 1;
 
+    __ALUSetFlags(cpu, kGBLazyFlagsDec, (*to), 1, __ALUCarry(cpu), result);
     (*to) = result;
 }
 
@@ -130,30 +261,21 @@ static INLINE void __ALUAnd8(GBProcessor *cpu, uint8_t *to, uint8_t from)
 {
     *to &= from;
 
-    cpu->state.f.z = !(*to);
-    cpu->state.f.n = 0;
-    cpu->state.f.h = 1;
-    cpu->state.f.c = 0;
+    __ALUSetFlags(cpu, kGBLazyFlagsAnd, 0, 0, 0, (*to));
 }
 
 static INLINE void __ALUXor8(GBProcessor *cpu, uint8_t *to, uint8_t from)
 {
     *to ^= from;
 
-    cpu->state.f.z = !(*to);
-    cpu->state.f.n = 0;
-    cpu->state.f.h = 0;
-    cpu->state.f.c = 0;
+    __ALUSetFlags(cpu, kGBLazyFlagsOr, 0, 0, 0, (*to));
 }
 
 static INLINE void __ALUOr8(GBProcessor *cpu, uint8_t *to, uint8_t from)
 {
     *to |= from;
 
-    cpu->state.f.z = !(*to);
-    cpu->state.f.n = 0;
-    cpu->state.f.h = 0;
-    cpu->state.f.c = 0;
+    __ALUSetFlags(cpu, kGBLazyFlagsOr, 0, 0, 0, (*to));
 }
 
 static INLINE void __ALUCP8(GBProcessor *cpu, uint8_t *to, uint8_t from)
@@ -165,17 +287,29 @@ static INLINE void __ALUCP8(GBProcessor *cpu, uint8_t *to, uint8_t from)
     *to = initial;
 }
 
-static INLINE void __ALURotateRight(uint8_t *reg)
+#pragma mark - Rotates and Shifts
+
+static INLINE uint8_t __ALUShift(GBProcessor *cpu, uint8_t kind, uint8_t value)
 {
-    (*reg) = ((*reg) << 7) | ((*reg) >> 1);
+    uint16_t entry = gGBALUShift[kind][__ALUCarry(cpu)][value];
+
+    __ALUStoreFlags(cpu, entry & 0xFF);
+
+    return entry >> 8;
 }
 
-static INLINE void __ALURotateLeft(uint8_t *reg)
+// The unprefixed rotates on a always clear z
+static INLINE void __ALURotateA(GBProcessor *cpu, uint8_t kind)
 {
-    (*reg) = ((*reg) >> 7) | ((*reg) << 1);
+    uint16_t entry = gGBALUShift[kind][__ALUCarry(cpu)][cpu->state.a];
+
+    __ALUStoreFlags(cpu, entry & ~kGBFlagZero);
+    cpu->state.a = entry >> 8;
 }
 
-#endif /* !defined(kGBDisassembler) */
+#endif /* !defined(kGBDisassembler) && !defined(kGBInstructionSetOpsOnly) */
+
+#ifndef kGBInstructionSetHelpersOnly
 
 #pragma mark - Data Formatting Macros
 
@@ -465,7 +599,7 @@ static INLINE void __ALURotateLeft(uint8_t *reg)
         {                                                                               \
             cpu->state.mode = kGBProcessorModeFetch;                                    \
                                                                                         \
-            return;                                                                     \
+            op_return;                                                                  \
         }                                                                               \
                                                                                         \
         cpu->state.pc += __ALUSignExtend(cpu->state.mdr);                               \
@@ -475,15 +609,15 @@ static INLINE void __ALURotateLeft(uint8_t *reg)
     op_wait2_stall(code, 3, "jp " str d16, {                                            \
         __GBProcessorReadArgument(cpu);                                                 \
     }, {                                                                                \
-        __GBProcessorReadArgument(cpu);                                                 \
-                                                                                        \
         cpu->state.data = cpu->state.mdr;                                               \
+                                                                                        \
+        __GBProcessorReadArgument(cpu);                                                 \
     }, {                                                                                \
         if (!cond)                                                                      \
         {                                                                               \
             cpu->state.mode = kGBProcessorModeFetch;                                    \
                                                                                         \
-            return;                                                                     \
+            op_return;                                                                  \
         }                                                                               \
                                                                                         \
         cpu->state.pc = cpu->state.data | (cpu->state.mdr << 8);                        \
@@ -513,7 +647,7 @@ static INLINE void __ALURotateLeft(uint8_t *reg)
                 {                                                                       \
                     cpu->state.mode = kGBProcessorModeFetch;                            \
                                                                                         \
-                    return;                                                             \
+                    op_return;                                                          \
                 }                                                                       \
                                                                                         \
                 __GBProcessorWrite(cpu, cpu->state.sp - 1, cpu->state.pc >> 8);         \
@@ -550,14 +684,14 @@ static INLINE void __ALURotateLeft(uint8_t *reg)
         {                                                                               \
             cpu->state.mode = kGBProcessorModeFetch;                                    \
                                                                                         \
-            return;                                                                     \
+            op_return;                                                                  \
         }                                                                               \
                                                                                         \
         __GBProcessorRead(cpu, cpu->state.sp + 0);                                      \
     }, {                                                                                \
-        __GBProcessorRead(cpu, cpu->state.sp + 1);                                      \
-                                                                                        \
         cpu->state.pc = cpu->state.mdr;                                                 \
+                                                                                        \
+        __GBProcessorRead(cpu, cpu->state.sp + 1);                                      \
     }, {                                                                                \
         cpu->state.pc |= cpu->state.mdr << 8;                                           \
         cpu->state.sp += 2;                                                             \
@@ -598,32 +732,24 @@ static INLINE void __ALURotateLeft(uint8_t *reg)
 
 #pragma mark - Undefined instruction macros
 
-#define udef(code)                                                                      \
-    op(code, 1, "ud " #code, {                                                          \
-        fprintf(stderr, "Error: Undefined instruction 0x%02X called.\n", this->value);  \
-        fprintf(stderr, "Note: A real gameboy would lockup here.\n");                   \
-                                                                                        \
-        cpu->state.mode = kGBProcessorModeOff;                                          \
+#define udef(code)                                                                        \
+    op(code, 1, "ud " #code, {                                                            \
+        fprintf(stderr, "Error: Undefined instruction 0x%02X called.\n", cpu->state.op);  \
+        fprintf(stderr, "Note: A real gameboy would lockup here.\n");                     \
+                                                                                          \
+        cpu->state.mode = kGBProcessorModeOff;                                            \
     })
 
 #pragma mark - Logical operation macros
 
 #define inc_r(code, reg)                                                    \
     op_simple(code, "inc " #reg, {                                          \
-        uint8_t carry = cpu->state.f.c;                                       \
-        uint8_t one = 1;                                                      \
-                                                                            \
-        __ALUAdd8(cpu, &cpu->state.reg, one, 0);                            \
-        cpu->state.f.c = carry;                                             \
+        __ALUInc8(cpu, &cpu->state.reg);                                    \
     })
 
 #define dec_r(code, reg)                                                    \
     op_simple(code, "dec " #reg, {                                          \
-        uint8_t carry = cpu->state.f.c;                                       \
-        uint8_t one = 1;                                                      \
-                                                                            \
-        __ALUSub8(cpu, &cpu->state.reg, one, 0);                            \
-        cpu->state.f.c = carry;                                             \
+        __ALUDec8(cpu, &cpu->state.reg);                                    \
     })
 
 #define inc_rr(code, regs)                                                  \
@@ -638,11 +764,11 @@ static INLINE void __ALURotateLeft(uint8_t *reg)
 
 #define add_hl(code, reg)                                                   \
     op_stall(code, 1, "add hl, " #reg, {                                    \
-        uint8_t zero = cpu->state.f.z;                                        \
+        uint8_t zero = __ALUFlags(cpu).z;                                   \
                                                                             \
         __ALUAdd16(cpu, &cpu->state.hl, cpu->state.reg, 0);                 \
                                                                             \
-        cpu->state.f.z = zero;                                              \
+        __ALUFlags(cpu).z = zero;                                           \
     })
 
 #define op_alu(code, name, reg, func, c)                                    \
@@ -652,11 +778,11 @@ static INLINE void __ALURotateLeft(uint8_t *reg)
 
 #define add(code, reg) op_alu(code, "add", reg, __ALUAdd8, 0)
 
-#define adc(code, reg) op_alu(code, "adc", reg, __ALUAdd8, cpu->state.f.c)
+#define adc(code, reg) op_alu(code, "adc", reg, __ALUAdd8, __ALUCarry(cpu))
 
 #define sub(code, reg) op_alu(code, "sub", reg, __ALUSub8, 0)
 
-#define sbc(code, reg) op_alu(code, "sbc", reg, __ALUSub8, cpu->state.f.c)
+#define sbc(code, reg) op_alu(code, "sbc", reg, __ALUSub8, __ALUCarry(cpu))
 
 #define alu_op(code, name, reg, func)                                       \
     op_simple(code, name " " #reg, {                                        \
@@ -697,12 +823,7 @@ dec_r(0x05, b);
 ld_m(0x06, b);
 
 op_simple(0x07, "rcla", {
-    __ALURotateLeft(&cpu->state.a);
-
-    cpu->state.f.z = 0;
-    cpu->state.f.n = 0;
-    cpu->state.f.h = 0;
-    cpu->state.f.c = cpu->state.a & 1;
+    __ALURotateA(cpu, kGBALUShiftRLC);
 });
 
 op(0x08, 3, "ld (" d16 "), sp", {
@@ -758,12 +879,7 @@ dec_r(0x0D, c);
 ld_m(0x0E, c);
 
 op_simple(0x0F, "rrca", {
-    cpu->state.f.c = cpu->state.a & 1;
-    cpu->state.f.h = 0;
-    cpu->state.f.n = 0;
-    cpu->state.f.z = 0;
-
-    __ALURotateRight(&cpu->state.a);
+    __ALURotateA(cpu, kGBALUShiftRRC);
 });
 
 op(0x10, 2, "stop 0", {
@@ -785,14 +901,7 @@ dec_r(0x15, d);
 ld_m(0x16, d);
 
 op_simple(0x17, "rla", {
-    cpu->state.f.z = 0;
-    cpu->state.f.n = 0;
-    cpu->state.f.h = cpu->state.f.c;
-    cpu->state.f.c = cpu->state.a >> 7;
-
-    cpu->state.a <<= 1;
-    cpu->state.a |= cpu->state.f.h;
-    cpu->state.f.h = 0;
+    __ALURotateA(cpu, kGBALUShiftRL);
 });
 
 jr(0x18, "", true);
@@ -809,17 +918,10 @@ dec_r(0x1D, e);
 ld_m(0x1E, e);
 
 op_simple(0x1F, "rra", {
-    cpu->state.f.z = 0;
-    cpu->state.f.n = 0;
-    cpu->state.f.h = cpu->state.f.c;
-    cpu->state.f.c = cpu->state.a & 1;
-
-    cpu->state.a >>= 1;
-    cpu->state.a |= cpu->state.f.h << 7;
-    cpu->state.f.h = 0;
+    __ALURotateA(cpu, kGBALUShiftRR);
 });
 
-jr(0x20, "nz, ", !cpu->state.f.z);
+jr(0x20, "nz, ", !__ALUZero(cpu));
 
 ld_rr(0x21, hl);
 
@@ -837,28 +939,13 @@ dec_r(0x25, h);
 ld_m(0x26, h);
 
 op_simple(0x27, "daa", {
-    if (cpu->state.f.n) {
-        if (cpu->state.f.c)
-            cpu->state.a -= 0x60;
-
-        if (cpu->state.f.h)
-            cpu->state.a -= 0x06;
-    } else {
-        if (cpu->state.f.c || cpu->state.a > 0x99)
-        {
-            cpu->state.a += 0x60;
-            cpu->state.f.c = 1;
-        }
-
-        if (cpu->state.f.h || (cpu->state.a & 0x0F) > 0x09)
-            cpu->state.a += 0x06;
-    }
+    uint16_t entry = gGBALUDecimalAdjust[((__ALUFlags(cpu).reg & (kGBFlagSubtract | kGBFlagHalfCarry | kGBFlagCarry)) << 4) | cpu->state.a];
 
-    cpu->state.f.z = !cpu->state.a;
-    cpu->state.f.h = 0;
+    __ALUStoreFlags(cpu, entry & 0xFF);
+    cpu->state.a = entry >> 8;
 });
 
-jr(0x28, "z, ", cpu->state.f.z);
+jr(0x28, "z, ", __ALUZero(cpu));
 
 add_hl(0x29, hl);
 
@@ -877,11 +964,11 @@ ld_m(0x2E, l);
 op_simple(0x2F, "cpl", {
     cpu->state.a = ~cpu->state.a;
 
-    cpu->state.f.h = 1;
-    cpu->state.f.n = 1;
+    __ALUFlags(cpu).h = 1;
+    __ALUFlags(cpu).n = 1;
 });
 
-jr(0x30, "nc, ", !cpu->state.f.c);
+jr(0x30, "nc, ", !__ALUCarry(cpu));
 
 ld_rr(0x31, sp);
 
@@ -896,11 +983,7 @@ inc_rr(0x33, sp);
 op_wait2(0x34, 1, "inc (hl)", {
     __GBProcessorRead(cpu, cpu->state.hl);
 }, {
-    uint8_t carry = cpu->state.f.c;
-    uint8_t one = 1;
-
-    __ALUAdd8(cpu, &cpu->state.mdr, one, 0);
-    cpu->state.f.c = carry;
+    __ALUInc8(cpu, &cpu->state.mdr);
 
     __GBProcessorWrite(cpu, cpu->state.hl, cpu->state.mdr);
 }, {
@@ -910,11 +993,7 @@ op_wait2(0x34, 1, "inc (hl)", {
 op_wait2(0x35, 1, "dec (hl)", {
     __GBProcessorRead(cpu, cpu->state.hl);
 }, {
-    uint8_t carry = cpu->state.f.c;
-    uint8_t one = 1;
-
-    __ALUSub8(cpu, &cpu->state.mdr, one, 0);
-    cpu->state.f.c = carry;
+    __ALUDec8(cpu, &cpu->state.mdr);
 
     __GBProcessorWrite(cpu, cpu->state.hl, cpu->state.mdr);
 }, {
@@ -930,13 +1009,13 @@ op_wait2(0x36, 2, "ld (hl), " d8, {
 });
 
 op_simple(0x37, "scf", {
-    cpu->state.f.c = 1;
+    __ALUFlags(cpu).c = 1;
 
-    cpu->state.f.h = 0;
-    cpu->state.f.n = 0;
+    __ALUFlags(cpu).h = 0;
+    __ALUFlags(cpu).n = 0;
 });
 
-jr(0x38, "c, ", cpu->state.f.c);
+jr(0x38, "c, ", __ALUCarry(cpu));
 
 add_hl(0x39, sp);
 
@@ -953,10 +1032,10 @@ dec_r(0x3D, a);
 ld_m(0x3E, a);
 
 op_simple(0x3F, "ccf", {
-    cpu->state.f.c = ~cpu->state.f.c;
+    __ALUFlags(cpu).c = ~__ALUFlags(cpu).c;
 
-    cpu->state.f.h = 0;
-    cpu->state.f.n = 0;
+    __ALUFlags(cpu).h = 0;
+    __ALUFlags(cpu).n = 0;
 });
 
 ld_r(0x40, b, b);
@@ -1059,7 +1138,7 @@ adc(0x8C, h);
 adc(0x8D, l);
 
 op_hl(0x8E, "adc a, (hl)", {
-    __ALUAdd8(cpu, &cpu->state.a, cpu->state.mdr, cpu->state.f.c);
+    __ALUAdd8(cpu, &cpu->state.a, cpu->state.mdr, __ALUCarry(cpu));
 });
 
 adc(0x8F, a);
@@ -1085,7 +1164,7 @@ sbc(0x9C, h);
 sbc(0x9D, l);
 
 op_hl(0x9E, "sbc a, (hl)", {
-    __ALUSub8(cpu, &cpu->state.a, cpu->state.mdr, cpu->state.f.c);
+    __ALUSub8(cpu, &cpu->state.a, cpu->state.mdr, __ALUCarry(cpu));
 });
 
 sbc(0x9F, a);
@@ -1134,12 +1213,12 @@ alu_op_hl(0xBE, "cp", __ALUCP8);
 
 cmp(0xBF, a);
 
-ret(0xC0, "nz", !cpu->state.f.z);
+ret(0xC0, "nz", !__ALUZero(cpu));
 
 pop(0xC1, bc);
-jmp(0xC2, "nz, ", !cpu->state.f.z);
+jmp(0xC2, "nz, ", !__ALUZero(cpu));
 jmp(0xC3, "", true);
-call(0xC4, "nz, ", !cpu->state.f.z);
+call(0xC4, "nz, ", !__ALUZero(cpu));
 
 push(0xC5, bc);
 
@@ -1148,7 +1227,7 @@ op_arg(0xC6, "add a, " d8, {
 });
 
 rst(0xC7, 0x00);
-ret(0xC8, "z", cpu->state.f.z);
+ret(0xC8, "z", __ALUZero(cpu));
 
 op_wait2_stall(0xC9, 1, "ret", {
     __GBProcessorRead(cpu, cpu->state.sp + 0);
@@ -1161,23 +1240,23 @@ op_wait2_stall(0xC9, 1, "ret", {
     cpu->state.sp += 2;
 });
 
-jmp(0xCA, "z, ", cpu->state.f.z);
+jmp(0xCA, "z, ", __ALUZero(cpu));
 
 op(0xCB, 1, "cb.", { /* This is the prefix opcode */ });
 
-call(0xCC, "z, ", cpu->state.f.z);
+call(0xCC, "z, ", __ALUZero(cpu));
 call(0xCD, "", true);
 
 op_arg(0xCE, "adc a, " d8, {
-    __ALUAdd8(cpu, &cpu->state.a, cpu->state.mdr, cpu->state.f.c);
+    __ALUAdd8(cpu, &cpu->state.a, cpu->state.mdr, __ALUCarry(cpu));
 });
 
 rst(0xCF, 0x08);
-ret(0xD0, "nc", !cpu->state.f.c);
+ret(0xD0, "nc", !__ALUCarry(cpu));
 pop(0xD1, de);
-jmp(0xD2, "nc, ", !cpu->state.f.c);
+jmp(0xD2, "nc, ", !__ALUCarry(cpu));
 udef(0xD3);
-call(0xD4, "nc, ", !cpu->state.f.c);
+call(0xD4, "nc, ", !__ALUCarry(cpu));
 push(0xD5, de);
 
 op_arg(0xD6, "sub " d8, {
@@ -1185,7 +1264,7 @@ op_arg(0xD6, "sub " d8, {
 });
 
 rst(0xD7, 0x10);
-ret(0xD8, "c", cpu->state.f.c);
+ret(0xD8, "c", __ALUCarry(cpu));
 
 op_wait2_stall(0xD9, 1, "reti", {
     __GBProcessorRead(cpu, cpu->state.sp + 0);
@@ -1200,14 +1279,14 @@ op_wait2_stall(0xD9, 1, "reti", {
     cpu->state.sp += 2;
 });
 
-jmp(0xDA, "c, ", cpu->state.f.c);
+jmp(0xDA, "c, ", __ALUCarry(cpu));
 udef(0xDB);
 
-call(0xDC, "c, ", cpu->state.f.c);
+call(0xDC, "c, ", __ALUCarry(cpu));
 udef(0xDD);
 
 op_arg(0xDE, "sbc " d8, {
-    __ALUSub8(cpu, &cpu->state.a, cpu->state.mdr, cpu->state.f.c);
+    __ALUSub8(cpu, &cpu->state.a, cpu->state.mdr, __ALUCarry(cpu));
 });
 
 rst(0xDF, 0x18);
@@ -1236,13 +1315,13 @@ alu_op_arg(0xE6, "and", __ALUAnd8);
 
 rst(0xE7, 0x20);
 
-op_wait3_stall(0xE8, 1, "add sp, " d8, {
+op_wait3_stall(0xE8, 2, "add sp, " d8, {
     __GBProcessorReadArgument(cpu);
 }, {
     __ALUAdd16(cpu, &cpu->state.sp, __ALUSignExtend(cpu->state.mdr), 0);
 }, {
     __GBProcessorRead(cpu, 0x0000);
-    cpu->state.f.z = 0;
+    __ALUFlags(cpu).z = 0;
 }, {
     // Stalling more...
 });
@@ -1282,7 +1361,7 @@ op_wait2(0xF0, 2, "ld a, " d8 "(" dIO ")", {
 op_wait2_stall(0xF1, 1, "pop af", {
     __GBProcessorRead(cpu, cpu->state.sp + 0);
 }, {
-    cpu->state.f.reg = cpu->state.mdr & 0xF0;
+    __ALUFlags(cpu).reg = cpu->state.mdr & 0xF0;
 
     __GBProcessorRead(cpu, cpu->state.sp + 1);
 }, {
@@ -1307,7 +1386,7 @@ udef(0xF4);
 op_wait2_stall(0xF5, 1, "push af", {
     __GBProcessorWrite(cpu, cpu->state.sp - 1, cpu->state.a);
 }, {
-    __GBProcessorWrite(cpu, cpu->state.sp - 2, cpu->state.f.reg & 0xF0);
+    __GBProcessorWrite(cpu, cpu->state.sp - 2, __ALUFlags(cpu).reg & 0xF0);
 }, {
     cpu->state.sp -= 2;
 });
@@ -1324,12 +1403,12 @@ op_wait2_stall(0xF8, 2, "ld hl, " d8 "(sp)", {
     uint16_t val = __ALUSignExtend(cpu->state.mdr);
 
     __ALUAdd8(cpu, (uint8_t *)&cpu->state.hl, val & 0xFF, 0);
-    uint8_t h = cpu->state.f.h;
-    uint8_t c = cpu->state.f.c;
+    uint8_t h = __ALUFlags(cpu).h;
+    uint8_t c = __ALUFlags(cpu).c;
 
-    __ALUAdd8(cpu, ((uint8_t *)&cpu->state.hl) + 1, val >> 8, cpu->state.f.c);
-    cpu->state.f.h = h;
-    cpu->state.f.c = c;
+    __ALUAdd8(cpu, ((uint8_t *)&cpu->state.hl) + 1, val >> 8, __ALUCarry(cpu));
+    __ALUFlags(cpu).h = h;
+    __ALUFlags(cpu).c = c;
 
     //__ALUAdd8(cpu, (uint8_t *)(to) + 0, from & 0xFF, carry);
     //__ALUAdd8(cpu, (uint8_t *)(to) + 1, from >> 8, cpu->state.f.c);
@@ -1337,7 +1416,7 @@ op_wait2_stall(0xF8, 2, "ld hl, " d8 "(sp)", {
 
     cpu->state.hl = cpu->state.sp;
     cpu->state.sp = sp;
-    cpu->state.f.z = 0;
+    __ALUFlags(cpu).z = 0;
 }, {
     // That's it
 });
@@ -1373,188 +1452,52 @@ rst(0xFF, 0x38);
 
 #pragma mark - Prefixed Instructions
 
-#define rlc(code, reg)                                                      \
-    op_pre_simple(code, "rlc " #reg, {                                      \
-        __ALURotateLeft(&cpu->state.reg);                                   \
-                                                                            \
-        cpu->state.f.z = !cpu->state.reg;                                   \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = cpu->state.reg & 1;                                \
+#define shift(code, name, reg, kind)                                        \
+    op_pre_simple(code, name " " #reg, {                                    \
+        cpu->state.reg = __ALUShift(cpu, kind, cpu->state.reg);             \
     })
 
-#define rlc_hl(code)                                                        \
-    op_pre_hl(code, "rlc (hl)", {                                           \
-        __ALURotateLeft(&cpu->state.mdr);                                   \
-                                                                            \
-        cpu->state.f.z = !cpu->state.mdr;                                   \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = cpu->state.mdr & 1;                                \
+#define shift_hl(code, name, kind)                                          \
+    op_pre_hl(code, name " (hl)", {                                         \
+        cpu->state.mdr = __ALUShift(cpu, kind, cpu->state.mdr);             \
     })
 
-#define rrc(code, reg)                                                      \
-    op_pre_simple(code, "rrc " #reg, {                                      \
-        cpu->state.f.z = !cpu->state.reg;                                   \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = cpu->state.reg & 1;                                \
-                                                                            \
-        __ALURotateRight(&cpu->state.reg);                                  \
-    })
+#define rlc(code, reg) shift(code, "rlc", reg, kGBALUShiftRLC)
+#define rlc_hl(code) shift_hl(code, "rlc", kGBALUShiftRLC)
 
-#define rrc_hl(code)                                                        \
-    op_pre_hl(code, "rrc (hl)", {                                           \
-        cpu->state.f.z = !cpu->state.mdr;                                   \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = cpu->state.mdr & 1;                                \
-                                                                            \
-        __ALURotateRight(&cpu->state.mdr);                                  \
-    })
+#define rrc(code, reg) shift(code, "rrc", reg, kGBALUShiftRRC)
+#define rrc_hl(code) shift_hl(code, "rrc", kGBALUShiftRRC)
 
-#define rl(code, reg)                                                       \
-    op_pre_simple(code, "rl " #reg, {                                       \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = cpu->state.f.c;                                    \
-        cpu->state.f.c = cpu->state.reg >> 7;                               \
-                                                                            \
-        cpu->state.reg <<= 1;                                               \
-        cpu->state.reg |= cpu->state.f.h;                                   \
-        cpu->state.f.z = !cpu->state.reg;                                   \
-        cpu->state.f.h = 0;                                                 \
-    })
-
-#define rl_hl(code)                                                         \
-    op_pre_hl(code, "rl (hl)", {                                            \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = cpu->state.f.c;                                    \
-        cpu->state.f.c = cpu->state.mdr >> 7;                               \
-                                                                            \
-        cpu->state.mdr <<= 1;                                               \
-        cpu->state.mdr |= cpu->state.f.h;                                   \
-        cpu->state.f.z = !cpu->state.mdr;                                   \
-        cpu->state.f.h = 0;                                                 \
-    })
+#define rl(code, reg) shift(code, "rl", reg, kGBALUShiftRL)
+#define rl_hl(code) shift_hl(code, "rl", kGBALUShiftRL)
 
-#define rr(code, reg)                                                       \
-    op_pre_simple(code, "rr " #reg, {                                       \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = cpu->state.f.c;                                    \
-        cpu->state.f.c = cpu->state.reg & 1;                                \
-                                                                            \
-        cpu->state.reg >>= 1;                                               \
-        cpu->state.reg |= cpu->state.f.h << 7;                              \
-        cpu->state.f.z = !cpu->state.reg;                                   \
-        cpu->state.f.h = 0;                                                 \
-    })
+#define rr(code, reg) shift(code, "rr", reg, kGBALUShiftRR)
+#define rr_hl(code) shift_hl(code, "rr", kGBALUShiftRR)
 
-#define rr_hl(code)                                                         \
-    op_pre_hl(code, "rr (hl)", {                                            \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = cpu->state.f.c;                                    \
-        cpu->state.f.c = cpu->state.mdr & 1;                                \
-                                                                            \
-        cpu->state.mdr >>= 1;                                               \
-        cpu->state.mdr |= cpu->state.f.h << 7;                              \
-        cpu->state.f.z = !cpu->state.mdr;                                   \
-        cpu->state.f.h = 0;                                                 \
-    })
+#define sla(code, reg) shift(code, "sla", reg, kGBALUShiftSLA)
+#define sla_hl(code) shift_hl(code, "sla", kGBALUShiftSLA)
 
-#define sla(code, reg)                                                      \
-    op_pre_simple(code, "sla " #reg, {                                      \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = cpu->state.reg >> 7;                               \
-                                                                            \
-        cpu->state.reg <<= 1;                                               \
-        cpu->state.f.z = !cpu->state.reg;                                   \
-    })
+#define sra(code, reg) shift(code, "sra", reg, kGBALUShiftSRA)
+#define sra_hl(code) shift_hl(code, "sra", kGBALUShiftSRA)
 
-#define sla_hl(code)                                                        \
-    op_pre_hl(code, "sla (hl)", {                                           \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = cpu->state.mdr >> 7;                               \
-                                                                            \
-        cpu->state.mdr <<= 1;                                               \
-        cpu->state.f.z = !cpu->state.mdr;                                   \
-    })
+#define swap(code, reg) shift(code, "swap", reg, kGBALUShiftSwap)
+#define swap_hl(code) shift_hl(code, "swap", kGBALUShiftSwap)
 
-#define sra(code, reg)                                                      \
-    op_pre_simple(code, "sra " #reg, {                                      \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = cpu->state.reg & 1;                                \
-                                                                            \
-        cpu->state.reg >>= 1;                                               \
-        cpu->state.reg |= (cpu->state.reg & 0x40) << 1;                     \
-        cpu->state.f.z = !cpu->state.reg;                                   \
-    })
-
-#define sra_hl(code)                                                        \
-    op_pre_hl(code, "sra (hl)", {                                           \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = cpu->state.mdr & 1;                                \
-                                                                            \
-        cpu->state.mdr >>= 1;                                               \
-        cpu->state.mdr |= (cpu->state.mdr & 0x40) << 1;                     \
-        cpu->state.f.z = !cpu->state.mdr;                                   \
-    })
-
-#define swap(code, reg)                                                     \
-    op_pre_simple(code, "swap " #reg, {                                     \
-        cpu->state.reg = (cpu->state.reg >> 4) | (cpu->state.reg << 4);     \
-                                                                            \
-        cpu->state.f.z = !cpu->state.reg;                                   \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = 0;                                                 \
-    })
-
-#define swap_hl(code)                                                       \
-    op_pre_hl(code, "swap (hl)", {                                          \
-        cpu->state.mdr = (cpu->state.mdr >> 4) | (cpu->state.mdr << 4);     \
-                                                                            \
-        cpu->state.f.z = !cpu->state.mdr;                                   \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = 0;                                                 \
-    })
-
-#define srl(code, reg)                                                      \
-    op_pre_simple(code, "srl " #reg, {                                      \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = cpu->state.reg & 1;                                \
-                                                                            \
-        cpu->state.reg >>= 1;                                               \
-        cpu->state.f.z = !cpu->state.reg;                                   \
-    })
-
-#define srl_hl(code)                                                        \
-    op_pre_hl(code, "srl (hl)", {                                           \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 0;                                                 \
-        cpu->state.f.c = cpu->state.mdr & 1;                                \
-                                                                            \
-        cpu->state.mdr >>= 1;                                               \
-        cpu->state.f.z = !cpu->state.mdr;                                   \
-    })
+#define srl(code, reg) shift(code, "srl", reg, kGBALUShiftSRL)
+#define srl_hl(code) shift_hl(code, "srl", kGBALUShiftSRL)
 
 #define bit(code, pos, reg)                                                 \
     op_pre_simple(code, "bit " #pos ", " #reg, {                            \
-        cpu->state.f.z = !((cpu->state.reg >> pos) & 1);                    \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 1;                                                 \
+        __ALUFlags(cpu).z = !((cpu->state.reg >> pos) & 1);                 \
+        __ALUFlags(cpu).n = 0;                                              \
+        __ALUFlags(cpu).h = 1;                                              \
     })
 
 #define bit_hl(code, pos)                                                   \
     op_pre_hl(code, "bit " #pos ", (hl)", {                                 \
-        cpu->state.f.z = !((cpu->state.mdr >> pos) & 1);                    \
-        cpu->state.f.n = 0;                                                 \
-        cpu->state.f.h = 1;                                                 \
+        __ALUFlags(cpu).z = !((cpu->state.mdr >> pos) & 1);                 \
+        __ALUFlags(cpu).n = 0;                                              \
+        __ALUFlags(cpu).h = 1;                                              \
     })
 
 #define res(code, pos, reg)                                                 \
@@ -1658,7 +1601,7 @@ set(0xF8, 7, b); set(0xF9, 7, c); set(0xFA, 7, d); set(0xFB, 7, e); set(0xFC, 7,
 #undef rrc
 #undef rlc
 
-#ifndef kGBDisassembler
+#if !defined(kGBDisassembler) && !defined(kGBInstructionSetOpsOnly)
 
 #define expand(v, p)                                                                        \
     &op_ ## p ## v ## 0, &op_ ## p ## v ## 1, &op_ ## p ## v ## 2, &op_ ## p ## v ## 3,     \
@@ -1687,4 +1630,8 @@ static const GBProcessorOP *const gGBInstructionSetCB[0x100] = {
 #undef op
 #undef declare
 
-#endif /* !defined(kGBDisassembler) */
+#endif /* !defined(kGBDisassembler) && !defined(kGBInstructionSetOpsOnly) */
+
+#undef op_return
+
+#endif /* !defined(kGBInstructionSetHelpersOnly) */
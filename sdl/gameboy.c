@@ -1,10 +1,8 @@
 #include "gameboy.h"
 
 #include <libgb/disasm.h>
-#include <sys/stat.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <fcntl.h>
+#include <string.h>
 
 __attribute__((section("__TEXT,__rom"))) uint8_t gGBDMGEditedROM[0x100] = {
     0x31, 0xFE, 0xFF, 0xAF, 0x21, 0xFF, 0x9F, 0x32, 0xCB, 0x7C, 0x20, 0xFB, 0x21, 0x26, 0xFF, 0x0E,
@@ -55,6 +53,8 @@ GBGameboy *gameboy_init(void)
         return NULL;
     }
 
+    gameboy->driver->indexed = true;
+
     GBBIOSROM *bios = GBBIOSROMCreate(gGBDMGEditedROM);
 
     if (!bios)
@@ -80,52 +80,27 @@ bool gameboy_eject(GBGameboy *gameboy)
 
 bool gameboy_load_file(GBGameboy *gameboy, const char *path)
 {
-    struct stat stats;
-
-    if (stat(path, &stats))
-    {
-        perror("stat");
-        return false;
-    }
-
-    void *buf = malloc(stats.st_size);
-
-    if (!buf)
-    {
-        perror("malloc");
-        return false;
-    }
-
-    int fd = open(path, O_RDONLY);
-
-    if (fd < 0)
-    {
-        perror("open");
-        free(buf);
-
-        return false;
-    }
+    // Runs straight out of a read-only mapping of the file
+    GBCartridge *cart = GBCartridgeCreateWithFile(path);
+    if (!cart) { return false; }
 
-    if (read(fd, buf, stats.st_size) < 0)
-    {
-        perror("read");
-        close(fd);
-        free(buf);
+    // Battery RAM lives next to the ROM as 'name.sav'
+    size_t length = strlen(path);
+    const char *extension = strrchr(path, '.');
+    const char *separator = strrchr(path, '/');
+    if (extension && (!separator || extension > separator)) { length = extension - path; }
 
-        return false;
-    }
+    char *save = malloc(length + sizeof(".sav"));
 
-    if (close(fd))
+    if (save)
     {
-        perror("close");
-        free(buf);
+        memcpy(save, path, length);
+        strcpy(save + length, ".sav");
 
-        return false;
+        GBCartridgeAttachSave(cart, save);
+        free(save);
     }
 
-    GBCartridge *cart = GBCartridgeCreate(buf, stats.st_size);
-    if (!cart) { return false; }
-
     return GBGameboyInsertCartridge(gameboy, cart);
 }
 
@@ -137,6 +112,31 @@ void gameboy_keyup(GBGameboy *gameboy, int key) {
     GBGamepadSetKeyState(gameboy->gamepad, key, false);
 }
 
+static bool gameboy_check_breakpoint(GBGameboy *gameboy, void *context)
+{
+    struct brk_info *breakpoint = context;
+
+    if (breakpoint->addr_active)
+    {
+        if (gameboy->cpu->state.pc == breakpoint->addr)
+        {
+            breakpoint->trigger_addr = true;
+            return false;
+        }
+    }
+
+    if (breakpoint->op_active)
+    {
+        if (breakpoint->op == _op(gameboy))
+        {
+            breakpoint->trigger_op = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // The Mac OS X version of this app didn't have tick limited and woudl stall very badly.
 // We usually only hit the limit if something bad happens and starts logging too much,
 //   but I include this here as it's quite nice to not have the app lock up if it falls behind.
@@ -156,39 +156,27 @@ int64_t gameboy_tick(GBGameboy *gameboy, uint32_t ticks, uint64_t deadline, stru
         return 0;
     }
 
+    // Only look at every instruction if we have to.
+    if (breakpoint->addr_active || breakpoint->op_active) {
+        GBGameboySetInstructionHook(gameboy, gameboy_check_breakpoint, breakpoint);
+    } else {
+        GBGameboySetInstructionHook(gameboy, NULL, NULL);
+    }
+
     // Account ticks here.
     uint64_t res = 0;
 
-    // We may go slightly over, but never more than 12 ticks.
     while (res < ticks)
     {
-        uint32_t i = 0;
-
-        while (i < MIN(ticks - i, 100))
-        {
-            if (breakpoint->addr_active)
-            {
-                if (gameboy->cpu->state.pc == breakpoint->addr)
-                {
-                    breakpoint->trigger_addr = true;
-                    return (res + i);
-                }
-            }
-
-            if (breakpoint->op_active)
-            {
-                if (breakpoint->op == _op(gameboy))
-                {
-                    breakpoint->trigger_op = true;
-                    return (res + i);
-                }
-            }
-
-            i += gameboy_step_once(gameboy);
-        }
+        uint32_t chunk = MIN(ticks - res, GB_TICK_CHUNK);
+        uint64_t done = GBGameboyRunCycles(gameboy, chunk);
 
         // Account how many ticks we've just done.
-        res += i;
+        res += done;
+
+        // Hit a breakpoint (or turned off)
+        if (done < chunk)
+            break;
 
         if (SDL_GetTicksNS() > deadline)
         {
@@ -261,34 +249,24 @@ int gameboy_cpu_mode(GBGameboy *gameboy);
 
 static uint32_t _color_lookup[4] = { 0xEEEEEEFF, 0xBBBBBBFF, 0x555555FF, 0x000000FF };
 
-static void _decode_tile(uint8_t *source, uint32_t dest[kGBTileWidth * kGBTileHeight], uint8_t palette[4])
+static void _color_tile(const uint8_t *indices, uint32_t dest[kGBTileWidth * kGBTileHeight])
 {
-    for (int y = 0; y < (2 * kGBTileHeight); y += 2)
-    {
-        for (int x = 0; x < kGBTileWidth; x++)
-        {
-            uint8_t value = ((source[y + 1] >> x) & 2);
-            value |= (source[y] >> x) & 1;
+    for (int i = 0; i < (kGBTileWidth * kGBTileHeight); i++)
+        dest[i] = _color_lookup[indices[i]];
+}
 
-            dest[(y * (kGBTileWidth / 2)) + (7 - x)] = _color_lookup[value];
-        }
-    }
+static void _decode_tile(GBGameboy *gameboy, uint16_t index, uint32_t dest[kGBTileWidth * kGBTileHeight], uint8_t palette[4])
+{
+    _color_tile(GBVideoRAMTile(gameboy->vram, index), dest);
 }
 
 void gameboy_decode_tileset_data(GBGameboy *gameboy, gb_tileset tileset)
 {
-    uint8_t raw_palette = _read(gameboy, kGBPalettePortBGAddress);
-    uint8_t *tileset_source = &gameboy->vram->memory[0];
-
-    uint8_t palette[4] = {
-        ((raw_palette >> 0) & 3),
-        ((raw_palette >> 2) & 3),
-        ((raw_palette >> 4) & 3),
-        ((raw_palette >> 6) & 3)
-    };
+    // Only tiles written since the last frame get decoded again
+    GBVideoRAMUpdateTiles(gameboy->vram);
 
     for (int i = 0; i < kGBTileCount; i++) {
-        _decode_tile(&tileset_source[i * (2 * kGBTileHeight)], tileset[i], palette);
+        _color_tile(gameboy->vram->tiles[i], tileset[i]);
     }
 }
 
@@ -340,8 +318,6 @@ void _copy_tile(uint32_t tile[kGBTileHeight * kGBTileWidth], int x, int y, void
 
 void gameboy_decode_sprite_data(GBGameboy *gameboy, uint32_t *dest, int stride)
 {
-    uint8_t *tileset_source = &gameboy->vram->memory[0];
-
     uint8_t palette_lo_raw = _read(gameboy, kGBPalettePortSprite0Address);
     uint8_t palette_hi_raw = _read(gameboy, kGBPalettePortSprite1Address);
 
@@ -371,7 +347,7 @@ void gameboy_decode_sprite_data(GBGameboy *gameboy, uint32_t *dest, int stride)
         GBSpriteDescriptor *descriptor = &gameboy->driver->oam->memory[i];
         uint8_t *palette = ((descriptor->attributes >> 4) & 1) ? palette_lo : palette_hi;
 
-        _decode_tile(&tileset_source[descriptor->pattern * (2 * kGBTileHeight)], tile, palette);
+        _decode_tile(gameboy, descriptor->pattern, tile, palette);
 
         int y = (i / 8) * (kGBTileHeight * 2);
         int x = (i % 8) * kGBTileWidth;
@@ -383,7 +359,7 @@ void gameboy_decode_sprite_data(GBGameboy *gameboy, uint32_t *dest, int stride)
         y += kGBTileHeight;
 
         if (twoTile) {
-            _decode_tile(&tileset_source[(descriptor->pattern + 1) * (2 * kGBTileHeight)], tile, palette);
+            _decode_tile(gameboy, descriptor->pattern + 1, tile, palette);
             _copy_tile(tile, x, y, dest, stride, flip_x, flip_y);
         } else {
             for (int j = 0; j < kGBTileHeight; j++)
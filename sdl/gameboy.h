@@ -10,6 +10,7 @@
 #endif /* !defined(SDLGB_DEBUG) */
 
 #define GB_CPS 4194304 /* Gameboy clock ticks per second */
+#define GB_TICK_CHUNK 0x4000 /* Ticks run between checks of the frame deadline */
 
 #define LOG(level,  msg, ...) SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ ## level, msg __VA_OPT__(,) __VA_ARGS__)
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
@@ -79,7 +80,12 @@ extern int gameboy_cpu_mode(GBGameboy *gameboy);
 
 // Accessing video memory
 
-#define gameboy_screendata(gameboy) ((gameboy)->driver->screenData)
+// The screen is drawn as shades, and only given colors (the driver's) when it's shown
+#define gameboy_convert_screen(gameboy, damage, dest) \
+    GBGraphicsDriverConvertScreen32((gameboy)->driver, (damage), NULL, (dest), kGBScreenWidth * sizeof(uint32_t))
+
+// Lines of the screen that changed since the last call (returns false if none did)
+#define gameboy_take_damage(gameboy, damage) GBGraphicsDriverTakeDamage((gameboy)->driver, (damage))
 
 #define kGBTileCount 384
 
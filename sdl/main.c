@@ -64,6 +64,7 @@ struct cmd_state {
 struct state {
     // Main GB screen + debug text
     struct window_state screen;
+    uint32_t screen_pixels[kGBScreenHeight * kGBScreenWidth];
     char debug_fps[8];
     char debug_cps[12];
     bool show_fps;
@@ -292,28 +293,67 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char **argv)
         }                                                                                   \
     } while (0)
 
+#define LINE_DAMAGED(damage, r) ((damage)[(r) / 32] & (1U << ((r) % 32)))
+
 static bool render_screen(struct state *state)
 {
-    uint32_t *screen_data = gameboy_screendata(state->gameboy);
+    uint32_t *screen_data = state->screen_pixels;
+    uint32_t damage[kGBDriverDamageWords];
 
-    void *pixels;
-    int pitch;
+    // The texture keeps what it had, so only runs of lines that changed are colored and sent.
+    // (Locking would hand back a write-only buffer we'd have to fill completely.)
+    if (gameboy_take_damage(state->gameboy, damage))
+    {
+        gameboy_convert_screen(state->gameboy, damage, screen_data);
 
-    RENDER_TEXTURED(state, &state->screen, MAIN_BYTES_PER_ROW, "Screen", {
-        for (int r = 0; r < kGBScreenHeight; r++)
+        for (int r = 0; r < kGBScreenHeight; )
         {
-            uint32_t *row = (uint32_t *)(pixels + (pitch * r));
-            memcpy(row, &screen_data[kGBScreenWidth * r], MAIN_BYTES_PER_ROW);
-        }
-    }, {
-        if (state->show_fps)
-        {
-            SDL_SetRenderDrawColor(state->screen.renderer, 255, 0, 255, 128);
-            SDL_RenderDebugText(state->screen.renderer, 8, 8, state->debug_fps);
-            SDL_RenderDebugText(state->screen.renderer, 8, 20, state->debug_cps);
-            SDL_SetRenderDrawColor(state->screen.renderer, 0, 0, 0, 255);
+            if (!LINE_DAMAGED(damage, r)) {
+                r++;
+                continue;
+            }
+
+            int start = r;
+
+            while (r < kGBScreenHeight && LINE_DAMAGED(damage, r)) {
+                r++;
+            }
+
+            SDL_Rect rect = { 0, start, kGBScreenWidth, r - start };
+
+            if (!SDL_UpdateTexture(state->screen.texture, &rect, &screen_data[kGBScreenWidth * start], MAIN_BYTES_PER_ROW))
+            {
+                report_error("Graphics Error", "Failed to update texture");
+                return false;
+            }
         }
-    });
+    }
+
+    if (!SDL_RenderClear(state->screen.renderer))
+    {
+        report_error("Graphics Error", "Failed to clear renderer");
+        return false;
+    }
+
+    if (!SDL_RenderTexture(state->screen.renderer, state->screen.texture, NULL, NULL))
+    {
+        report_error("Graphics Error", "Failed to render texture");
+        return false;
+    }
+
+    if (state->show_fps)
+    {
+        SDL_SetRenderDrawColor(state->screen.renderer, 255, 0, 255, 128);
+        SDL_RenderDebugText(state->screen.renderer, 8, 8, state->debug_fps);
+        SDL_RenderDebugText(state->screen.renderer, 8, 20, state->debug_cps);
+        SDL_SetRenderDrawColor(state->screen.renderer, 0, 0, 0, 255);
+    }
+
+    if (!SDL_RenderPresent(state->screen.renderer))
+    {
+        report_error("Graphics Error", "Failed to present renderer");
+        return false;
+    }
 
     return true;
 }
@@ -436,10 +476,13 @@ static bool render_debug(struct state *state)
     renderf(7, 10, "OP: 0x%04X", gameboy_op(state->gameboy));
     renderf(7, 22, "PRE: %d", cpustate->prefix);
 
-    renderf(8, 4,  "Z: %d", cpustate->f.z);
-    renderf(8, 9,  "N: %d", cpustate->f.n);
-    renderf(8, 14, "H: %d", cpustate->f.h);
-    renderf(8, 19, "C: %d", cpustate->f.c);
+    // The processor may not have worked out the flags from the last op yet
+    GBProcessorFlags flags = { .reg = GBProcessorReadFlags(state->gameboy->cpu) };
+
+    renderf(8, 4,  "Z: %d", flags.z);
+    renderf(8, 9,  "N: %d", flags.n);
+    renderf(8, 14, "H: %d", flags.h);
+    renderf(8, 19, "C: %d", flags.c);
 
     if (cpustate->mode == kGBProcessorModeFetch) {
         gameboy_current_insn(state->gameboy, state->last_insn);
@@ -920,6 +963,12 @@ static void handle_key_event(struct state *state, SDL_KeyboardEvent *event)
                 case SDL_SCANCODE_Z: state->paused = !state->paused;     break;
                 case SDL_SCANCODE_9: state->show_fps = !state->show_fps; break;
                 case SDL_SCANCODE_T: gameboy_tick_once(state->gameboy); break;
+                case SDL_SCANCODE_L: {
+                    GBGraphicsDriver *driver = state->gameboy->driver;
+
+                    GBGraphicsDriverSetScanline(driver, !driver->scanlineNext);
+                    LOG(INFO, "Using the %s renderer", driver->scanlineNext ? "scanline" : "per-dot");
+                } break;
                 case SDL_SCANCODE_J: {
                     uint16_t pc = state->gameboy->cpu->state.pc;
 
@@ -1071,5 +1120,6 @@ void SDL_AppQuit(void *appstate, SDL_AppResult result)
         LOG(ERROR, "App closing due to failure. Error: '%s'", SDL_GetError());
     }
 
+    GBDiagnosticsDump(stderr);
     SDL_Quit();
 }